@@ -0,0 +1,257 @@
+/*
+    MIT License
+
+    Copyright (c) 2018-2022 HolyWu
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "PlaneCopy.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLANECOPY_X86
+#include <immintrin.h>
+#endif
+
+// Planes larger than this don't fit in cache anyway, and libvmaf only reads them once the whole picture is copied, so
+// they are written with non-temporal stores to avoid evicting the source frame.
+static constexpr size_t streamThreshold{ 4 << 20 };
+
+static inline uint16_t reduceSample(uint16_t v, int shift, uint16_t peak) noexcept {
+    return std::min(static_cast<uint16_t>((v >> shift) + ((v >> (shift - 1)) & 1)), peak);
+}
+
+static void reduceRow(uint8_t* dst, const uint8_t* src, size_t rowBytes, int shift, uint16_t peak) noexcept {
+    auto dstp{ reinterpret_cast<uint16_t*>(dst) };
+    auto srcp{ reinterpret_cast<const uint16_t*>(src) };
+
+    for (size_t x{}; x < rowBytes / 2; x++)
+        dstp[x] = reduceSample(srcp[x], shift, peak);
+}
+
+// Raises 8-bit or 16-bit samples from x onwards into 16-bit samples with shift more bits.
+static void widenRow(uint8_t* dst, const uint8_t* src, int x, int width, int bytesPerSample, int shift) noexcept {
+    auto dstp{ reinterpret_cast<uint16_t*>(dst) };
+
+    if (bytesPerSample == 1) {
+        for (; x < width; x++)
+            dstp[x] = static_cast<uint16_t>(src[x] << shift);
+    } else {
+        auto srcp{ reinterpret_cast<const uint16_t*>(src) };
+
+        for (; x < width; x++)
+            dstp[x] = static_cast<uint16_t>(srcp[x] << shift);
+    }
+}
+
+static void widenPlaneC(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, int width, int height, int bytesPerSample,
+                        int shift) noexcept {
+    for (auto y{ 0 }; y < height; y++) {
+        widenRow(dst, src, 0, width, bytesPerSample, shift);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+static void copyPlaneC(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, size_t rowBytes, int height, int shift,
+                       uint16_t peak, [[maybe_unused]] bool stream) noexcept {
+    for (auto y{ 0 }; y < height; y++) {
+        if (shift)
+            reduceRow(dst, src, rowBytes, shift, peak);
+        else
+            std::memcpy(dst, src, rowBytes);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+#ifdef PLANECOPY_X86
+__attribute__((target("avx2")))
+static void copyPlaneAVX2(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, size_t rowBytes, int height, int shift,
+                          uint16_t peak, bool stream) noexcept {
+    const auto count{ _mm_cvtsi32_si128(shift) };
+    const auto roundCount{ _mm_cvtsi32_si128(std::max(shift - 1, 0)) };
+    const auto one{ _mm256_set1_epi16(1) };
+    const auto peakVec{ _mm256_set1_epi16(static_cast<short>(peak)) };
+
+    for (auto y{ 0 }; y < height; y++) {
+        size_t x{};
+
+        for (; x + 32 <= rowBytes; x += 32) {
+            auto v{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x)) };
+
+            if (shift)
+                v = _mm256_min_epu16(_mm256_add_epi16(_mm256_srl_epi16(v, count), _mm256_and_si256(_mm256_srl_epi16(v, roundCount), one)), peakVec);
+
+            if (stream)
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + x), v);
+            else
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+        }
+
+        if (shift)
+            reduceRow(dst + x, src + x, rowBytes - x, shift, peak);
+        else
+            std::memcpy(dst + x, src + x, rowBytes - x);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+
+    if (stream)
+        _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void widenPlaneAVX2(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, int width, int height, int bytesPerSample,
+                           int shift) noexcept {
+    const auto count{ _mm_cvtsi32_si128(shift) };
+
+    for (auto y{ 0 }; y < height; y++) {
+        auto dstp{ reinterpret_cast<uint16_t*>(dst) };
+        auto x{ 0 };
+
+        for (; x + 16 <= width; x += 16) {
+            auto v{ bytesPerSample == 1 ? _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)))
+                                        : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2)) };
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstp + x), _mm256_sll_epi16(v, count));
+        }
+
+        widenRow(dst, src, x, width, bytesPerSample, shift);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void widenPlaneAVX512(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, int width, int height, int bytesPerSample,
+                             int shift) noexcept {
+    const auto count{ _mm_cvtsi32_si128(shift) };
+
+    for (auto y{ 0 }; y < height; y++) {
+        auto dstp{ reinterpret_cast<uint16_t*>(dst) };
+        auto x{ 0 };
+
+        for (; x + 32 <= width; x += 32) {
+            auto v{ bytesPerSample == 1 ? _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x)))
+                                        : _mm512_loadu_si512(src + x * 2) };
+            _mm512_storeu_si512(dstp + x, _mm512_sll_epi16(v, count));
+        }
+
+        widenRow(dst, src, x, width, bytesPerSample, shift);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void copyPlaneAVX512(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride, size_t rowBytes, int height, int shift,
+                            uint16_t peak, bool stream) noexcept {
+    const auto count{ _mm_cvtsi32_si128(shift) };
+    const auto roundCount{ _mm_cvtsi32_si128(std::max(shift - 1, 0)) };
+    const auto one{ _mm512_set1_epi16(1) };
+    const auto peakVec{ _mm512_set1_epi16(static_cast<short>(peak)) };
+
+    for (auto y{ 0 }; y < height; y++) {
+        size_t x{};
+
+        for (; x + 64 <= rowBytes; x += 64) {
+            auto v{ _mm512_loadu_si512(src + x) };
+
+            if (shift)
+                v = _mm512_min_epu16(_mm512_add_epi16(_mm512_srl_epi16(v, count), _mm512_and_si512(_mm512_srl_epi16(v, roundCount), one)), peakVec);
+
+            if (stream)
+                _mm512_stream_si512(reinterpret_cast<__m512i*>(dst + x), v);
+            else
+                _mm512_storeu_si512(dst + x, v);
+        }
+
+        if (shift)
+            reduceRow(dst + x, src + x, rowBytes - x, shift, peak);
+        else
+            std::memcpy(dst + x, src + x, rowBytes - x);
+
+        src += srcStride;
+        dst += dstStride;
+    }
+
+    if (stream)
+        _mm_sfence();
+}
+#endif
+
+struct PlaneCopyImpl final {
+    void (*func)(uint8_t*, ptrdiff_t, const uint8_t*, ptrdiff_t, size_t, int, int, uint16_t, bool) noexcept;
+    void (*widen)(uint8_t*, ptrdiff_t, const uint8_t*, ptrdiff_t, int, int, int, int) noexcept;
+    const char* name;
+    size_t alignment;
+};
+
+static PlaneCopyImpl selectPlaneCopy() noexcept {
+#ifdef PLANECOPY_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return { copyPlaneAVX512, widenPlaneAVX512, "avx512", 64 };
+
+    if (__builtin_cpu_supports("avx2"))
+        return { copyPlaneAVX2, widenPlaneAVX2, "avx2", 32 };
+#endif
+
+    return { copyPlaneC, widenPlaneC, "c", 0 };
+}
+
+static const PlaneCopyImpl& planeCopyImpl() noexcept {
+    static const auto impl{ selectPlaneCopy() };
+    return impl;
+}
+
+void copyPlane(void* dst, ptrdiff_t dstStride, const void* src, ptrdiff_t srcStride, int width, int height, int bytesPerSample,
+               int bitsPerSample, int shift) noexcept {
+    auto& impl{ planeCopyImpl() };
+
+    if (shift < 0) {
+        impl.widen(static_cast<uint8_t*>(dst), dstStride, static_cast<const uint8_t*>(src), srcStride, width, height, bytesPerSample, -shift);
+        return;
+    }
+
+    auto rowBytes{ static_cast<size_t>(width) * bytesPerSample };
+    auto peak{ static_cast<uint16_t>((1 << (bitsPerSample - shift)) - 1) };
+
+    // Streaming stores need every row to start on a vector boundary.
+    auto stream{ impl.alignment &&
+                 rowBytes * height >= streamThreshold &&
+                 !(reinterpret_cast<uintptr_t>(dst) % impl.alignment) &&
+                 !(static_cast<size_t>(dstStride) % impl.alignment) };
+
+    impl.func(static_cast<uint8_t*>(dst), dstStride, static_cast<const uint8_t*>(src), srcStride, rowBytes, height, shift, peak, stream);
+}
+
+const char* planeCopyIsa() noexcept {
+    return planeCopyImpl().name;
+}
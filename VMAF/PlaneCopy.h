@@ -0,0 +1,37 @@
+/*
+    MIT License
+
+    Copyright (c) 2018-2022 HolyWu
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// Copies height rows of width samples from src to dst. With shift > 0 the samples must be 16-bit, and are reduced from
+// bitsPerSample to bitsPerSample - shift bits with rounding while being copied. With shift < 0 the samples are raised
+// by -shift bits into 16-bit samples in dst, whatever bytesPerSample is. The fastest implementation supported by the
+// CPU is selected on first use.
+void copyPlane(void* dst, ptrdiff_t dstStride, const void* src, ptrdiff_t srcStride, int width, int height, int bytesPerSample,
+               int bitsPerSample, int shift) noexcept;
+
+// Name of the implementation selected by copyPlane.
+const char* planeCopyIsa() noexcept;
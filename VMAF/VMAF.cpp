@@ -24,19 +24,48 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <VapourSynth4.h>
 #include <VSHelper4.h>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
 extern "C" {
 #include <libvmaf.h>
 }
 
+#include "PlaneCopy.h"
+
 using namespace std::literals;
 
 static constexpr const char* modelName[]{ "vmaf", "vmaf_neg", "vmaf_b", "vmaf_4k" };
@@ -44,109 +73,1539 @@ static constexpr const char* modelVersion[]{ "vmaf_v0.6.1", "vmaf_v0.6.1neg", "v
 
 static constexpr const char* featureName[]{ "psnr", "psnr_hvs", "float_ssim", "float_ms_ssim", "ciede" };
 
+static const std::vector<const char*> featureScoreNames[]{
+    { "psnr_y", "psnr_cb", "psnr_cr" },
+    { "psnr_hvs_y", "psnr_hvs_cb", "psnr_hvs_cr", "psnr_hvs" },
+    { "float_ssim" },
+    { "float_ms_ssim" },
+    { "ciede2000" },
+};
+
+// Rectangle of the input frames that is scored, in luma samples. Chroma planes use it scaled by the subsampling.
+struct Region final {
+    int left;
+    int top;
+    int width;
+    int height;
+};
+
+// libvmaf takes ownership of every picture passed to vmaf_read_pictures and releases its storage with its own
+// aligned free, so the planes of a VSFrame can't be handed over directly and always have to be copied. Only the
+// region is read from the source planes, so cropping needs no intermediate frame. The samples are shifted to the bit
+// depth of dst in the same pass: a positive shift lowers the depth of src, a negative one raises it.
+static void copyPicture(VmafPicture& dst, const VSFrame* src, int numPlanes, const Region& region, const VSAPI* vsapi) {
+    auto format{ vsapi->getVideoFrameFormat(src) };
+    auto shift{ format->bitsPerSample - static_cast<int>(dst.bpc) };
+
+    for (auto plane{ 0 }; plane < numPlanes; plane++) {
+        auto ssw{ plane ? format->subSamplingW : 0 };
+        auto ssh{ plane ? format->subSamplingH : 0 };
+        auto stride{ vsapi->getStride(src, plane) };
+
+        copyPlane(dst.data[plane],
+                  dst.stride[plane],
+                  vsapi->getReadPtr(src, plane) + (region.top >> ssh) * stride + (region.left >> ssw) * format->bytesPerSample,
+                  stride,
+                  region.width >> ssw,
+                  region.height >> ssh,
+                  format->bytesPerSample,
+                  format->bitsPerSample,
+                  shift);
+    }
+}
+
+// 64-bit hash of the region of the first numPlanes planes of src, read eight bytes at a time. It is only a cache key,
+// so it needs to be fast and well mixed rather than cryptographically strong.
+static uint64_t hashPicture(const VSFrame* src, int numPlanes, const Region& region, const VSAPI* vsapi) noexcept {
+    constexpr uint64_t prime1{ 0x9E3779B185EBCA87 };
+    constexpr uint64_t prime2{ 0xC2B2AE3D27D4EB4F };
+
+    auto format{ vsapi->getVideoFrameFormat(src) };
+    uint64_t hash{ prime1 };
+
+    auto mix{ [&](uint64_t word) noexcept {
+        hash ^= word * prime2;
+        hash = ((hash << 31) | (hash >> 33)) * prime1;
+    } };
+
+    for (auto plane{ 0 }; plane < numPlanes; plane++) {
+        auto ssw{ plane ? format->subSamplingW : 0 };
+        auto ssh{ plane ? format->subSamplingH : 0 };
+        auto stride{ vsapi->getStride(src, plane) };
+        auto srcp{ vsapi->getReadPtr(src, plane) + (region.top >> ssh) * stride + (region.left >> ssw) * format->bytesPerSample };
+        auto rowBytes{ static_cast<size_t>(region.width >> ssw) * format->bytesPerSample };
+
+        for (auto y{ 0 }; y < region.height >> ssh; y++) {
+            size_t x{};
+
+            for (; x + 8 <= rowBytes; x += 8) {
+                uint64_t word;
+                std::memcpy(&word, srcp + x, 8);
+                mix(word);
+            }
+
+            if (x < rowBytes) {
+                uint64_t word{};
+                std::memcpy(&word, srcp + x, rowBytes - x);
+                mix(word);
+            }
+
+            srcp += stride;
+        }
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// Shrinks bars (left, top, right, bottom) to the black borders of the luma plane of frame. A black frame tells nothing
+// about the borders and is skipped.
+template<typename T>
+static void findBlackBars(const VSFrame* frame, int threshold, std::array<int, 4>& bars, const VSAPI* vsapi) {
+    auto srcp{ reinterpret_cast<const T*>(vsapi->getReadPtr(frame, 0)) };
+    auto stride{ vsapi->getStride(frame, 0) / static_cast<ptrdiff_t>(sizeof(T)) };
+    auto width{ vsapi->getFrameWidth(frame, 0) };
+    auto height{ vsapi->getFrameHeight(frame, 0) };
+
+    auto isBlackRow = [&](int y) { return std::all_of(srcp + y * stride, srcp + y * stride + width, [&](T v) { return v <= threshold; }); };
+    auto isBlackColumn = [&](int x) {
+        for (auto y{ 0 }; y < height; y++)
+            if (srcp[y * stride + x] > threshold)
+                return false;
+        return true;
+    };
+
+    auto top{ 0 };
+    while (top < height && isBlackRow(top))
+        top++;
+
+    if (top == height)
+        return;
+
+    auto bottom{ 0 };
+    while (isBlackRow(height - 1 - bottom))
+        bottom++;
+
+    auto left{ 0 };
+    while (isBlackColumn(left))
+        left++;
+
+    auto right{ 0 };
+    while (isBlackColumn(width - 1 - right))
+        right++;
+
+    bars = { std::min(bars[0], left), std::min(bars[1], top), std::min(bars[2], right), std::min(bars[3], bottom) };
+}
+
+// Sets region from the crop or autocrop argument. Returns an error message, or nullptr on success.
+static const char* parseRegion(Region& region, const VSMap* in, VSNode* node, const char* filterName, VSCore* core, const VSAPI* vsapi) {
+    auto vi{ vsapi->getVideoInfo(node) };
+    auto numCrop{ vsapi->mapNumElements(in, "crop") };
+    int err;
+
+    auto autocrop{ vsapi->mapGetIntSaturated(in, "autocrop", 0, &err) };
+
+    if (numCrop > 0 && numCrop != 4)
+        return "crop must have 4 values: left, top, right and bottom";
+
+    if (autocrop < 0)
+        return "autocrop must be greater than or equal to 0";
+
+    if (numCrop > 0 && autocrop)
+        return "crop and autocrop can't be used together";
+
+    std::array<int, 4> crop{};
+
+    for (auto i{ 0 }; i < numCrop; i++) {
+        crop[i] = vsapi->mapGetIntSaturated(in, "crop", i, nullptr);
+
+        if (crop[i] < 0)
+            return "crop must be greater than or equal to 0";
+    }
+
+    if ((crop[0] | crop[2]) & ((1 << vi->format.subSamplingW) - 1) || (crop[1] | crop[3]) & ((1 << vi->format.subSamplingH) - 1))
+        return "crop must be a multiple of the chroma subsampling";
+
+    if (autocrop) {
+        // Somewhat above limited range black, to tolerate noise in the bars.
+        auto threshold{ 24 << (vi->format.bitsPerSample - 8) };
+        crop.fill(std::numeric_limits<int>::max());
+
+        for (auto n{ 0 }; n < std::min(autocrop, vi->numFrames); n++) {
+            char errorMsg[1024];
+            auto frame{ vsapi->getFrame(n, node, errorMsg, sizeof(errorMsg)) };
+
+            if (!frame)
+                return "failed to fetch frames for autocrop";
+
+            if (vi->format.bytesPerSample == 1)
+                findBlackBars<uint8_t>(frame, threshold, crop, vsapi);
+            else
+                findBlackBars<uint16_t>(frame, threshold, crop, vsapi);
+
+            vsapi->freeFrame(frame);
+        }
+
+        if (crop[0] == std::numeric_limits<int>::max())
+            crop.fill(0);
+
+        crop[0] &= ~((1 << vi->format.subSamplingW) - 1);
+        crop[1] &= ~((1 << vi->format.subSamplingH) - 1);
+        crop[2] &= ~((1 << vi->format.subSamplingW) - 1);
+        crop[3] &= ~((1 << vi->format.subSamplingH) - 1);
+
+        auto msg{ filterName + ": autocrop: left "s + std::to_string(crop[0]) + ", top " + std::to_string(crop[1]) +
+                  ", right " + std::to_string(crop[2]) + ", bottom " + std::to_string(crop[3]) };
+        vsapi->logMessage(mtInformation, msg.c_str(), core);
+    }
+
+    region = { crop[0], crop[1], vi->width - crop[0] - crop[2], vi->height - crop[1] - crop[3] };
+
+    if (region.width <= 0 || region.height <= 0)
+        return "crop leaves no picture";
+
+    return nullptr;
+}
+
+// Separable resampling weights along one dimension: output sample i is the weighted sum of taps consecutive input
+// samples beginning at start[i]. Edge taps are folded onto the border sample, so no bounds check is needed later.
+struct ResampleAxis final {
+    int taps;
+    std::vector<int> start;
+    std::vector<float> weights;
+};
+
+// Upscales (or downscales) a distorted rung to the reference geometry while copying it, and raises its bit depth to
+// the reference one in the same pass, so no intermediate full-resolution frame is ever materialized.
+struct Rescaler final {
+    std::array<ResampleAxis, 3> horizontal;
+    std::array<ResampleAxis, 3> vertical;
+    float scale;
+};
+
+static double bicubicKernel(double x) noexcept {
+    // b = 0, c = 0.6 as used by FFmpeg's default bicubic scaler.
+    constexpr auto c{ 0.6 };
+    x = std::abs(x);
+
+    if (x < 1.0)
+        return (2.0 - c) * x * x * x - (3.0 - c) * x * x + 1.0;
+    if (x < 2.0)
+        return -c * x * x * x + 5.0 * c * x * x - 8.0 * c * x + 4.0 * c;
+    return 0.0;
+}
+
+static double lanczosKernel(double x) noexcept {
+    constexpr auto taps{ 3.0 };
+    constexpr auto pi{ 3.14159265358979323846 };
+    x = std::abs(x);
+
+    if (x < 1e-8)
+        return 1.0;
+    if (x < taps)
+        return taps * std::sin(pi * x) * std::sin(pi * x / taps) / (pi * pi * x * x);
+    return 0.0;
+}
+
+static ResampleAxis makeResampleAxis(int srcSize, int dstSize, bool lanczos) {
+    auto support{ lanczos ? 3.0 : 2.0 };
+    auto ratio{ static_cast<double>(srcSize) / dstSize };
+    auto filterScale{ std::max(ratio, 1.0) };
+
+    ResampleAxis axis{};
+    axis.taps = std::min(static_cast<int>(std::ceil(support * filterScale)) * 2, srcSize);
+    axis.start.resize(dstSize);
+    axis.weights.resize(static_cast<size_t>(dstSize) * axis.taps);
+
+    for (auto i{ 0 }; i < dstSize; i++) {
+        auto center{ (i + 0.5) * ratio - 0.5 };
+        auto first{ static_cast<int>(std::floor(center)) - axis.taps / 2 + 1 };
+        auto start{ std::clamp(first, 0, srcSize - axis.taps) };
+        auto weights{ axis.weights.data() + static_cast<size_t>(i) * axis.taps };
+        auto sum{ 0.0 };
+
+        std::vector<double> w(axis.taps);
+        for (auto k{ 0 }; k < axis.taps; k++) {
+            auto x{ (first + k - center) / filterScale };
+            auto v{ lanczos ? lanczosKernel(x) : bicubicKernel(x) };
+            w[std::clamp(first + k, 0, srcSize - 1) - start] += v;
+            sum += v;
+        }
+
+        axis.start[i] = start;
+        for (auto k{ 0 }; k < axis.taps; k++)
+            weights[k] = static_cast<float>(w[k] / sum);
+    }
+
+    return axis;
+}
+
+template<typename S, typename D>
+static void resamplePlane(D* dst, ptrdiff_t dstStride, const S* src, ptrdiff_t srcStride, int srcHeight,
+                          const ResampleAxis& horizontal, const ResampleAxis& vertical, float scale, int peak) noexcept {
+    auto dstWidth{ static_cast<int>(horizontal.start.size()) };
+    auto dstHeight{ static_cast<int>(vertical.start.size()) };
+
+    // Reused across frames, so the intermediate buffer is only allocated once per thread.
+    thread_local std::vector<float> buffer;
+    buffer.resize(static_cast<size_t>(dstWidth) * (srcHeight + 1));
+    auto temp{ buffer.data() };
+    auto accum{ buffer.data() + static_cast<size_t>(dstWidth) * srcHeight };
+
+    for (auto y{ 0 }; y < srcHeight; y++) {
+        auto srcRow{ reinterpret_cast<const S*>(reinterpret_cast<const uint8_t*>(src) + y * srcStride) };
+        auto tempRow{ temp + static_cast<size_t>(y) * dstWidth };
+
+        for (auto x{ 0 }; x < dstWidth; x++) {
+            auto taps{ srcRow + horizontal.start[x] };
+            auto weights{ horizontal.weights.data() + static_cast<size_t>(x) * horizontal.taps };
+            auto sum{ 0.0f };
+
+            for (auto k{ 0 }; k < horizontal.taps; k++)
+                sum += weights[k] * taps[k];
+
+            tempRow[x] = sum;
+        }
+    }
+
+    // Row-wise accumulation keeps the vertical pass contiguous, which lets the compiler vectorize it.
+    for (auto y{ 0 }; y < dstHeight; y++) {
+        auto weights{ vertical.weights.data() + static_cast<size_t>(y) * vertical.taps };
+        auto dstRow{ reinterpret_cast<D*>(reinterpret_cast<uint8_t*>(dst) + y * dstStride) };
+
+        std::fill_n(accum, dstWidth, 0.0f);
+
+        for (auto k{ 0 }; k < vertical.taps; k++) {
+            auto tempRow{ temp + static_cast<size_t>(vertical.start[y] + k) * dstWidth };
+            auto w{ weights[k] * scale };
+
+            for (auto x{ 0 }; x < dstWidth; x++)
+                accum[x] += w * tempRow[x];
+        }
+
+        for (auto x{ 0 }; x < dstWidth; x++)
+            dstRow[x] = static_cast<D>(std::clamp(static_cast<int>(accum[x] + 0.5f), 0, peak));
+    }
+}
+
+static void rescalePicture(VmafPicture& dst, const VSFrame* src, int numPlanes, const Rescaler* rescaler, const VSAPI* vsapi) {
+    auto srcBytes{ vsapi->getVideoFrameFormat(src)->bytesPerSample };
+    auto peak{ (1 << dst.bpc) - 1 };
+
+    for (auto plane{ 0 }; plane < numPlanes; plane++) {
+        auto srcPtr{ vsapi->getReadPtr(src, plane) };
+        auto srcStride{ vsapi->getStride(src, plane) };
+        auto srcHeight{ vsapi->getFrameHeight(src, plane) };
+        auto& horizontal{ rescaler->horizontal[plane] };
+        auto& vertical{ rescaler->vertical[plane] };
+
+        if (srcBytes == 1 && dst.bpc == 8)
+            resamplePlane(static_cast<uint8_t*>(dst.data[plane]), dst.stride[plane], srcPtr, srcStride, srcHeight, horizontal, vertical, rescaler->scale, peak);
+        else if (srcBytes == 1)
+            resamplePlane(static_cast<uint16_t*>(dst.data[plane]), dst.stride[plane], srcPtr, srcStride, srcHeight, horizontal, vertical, rescaler->scale, peak);
+        else
+            resamplePlane(static_cast<uint16_t*>(dst.data[plane]), dst.stride[plane], reinterpret_cast<const uint16_t*>(srcPtr), srcStride, srcHeight,
+                          horizontal, vertical, rescaler->scale, peak);
+    }
+}
+
+enum Stage { stageUpstream, stageAlloc, stageCopy, stageReadPictures, stageFlush, stageCount };
+
+static constexpr const char* stageName[]{ "upstream", "alloc", "copy", "read_pictures", "flush" };
+static constexpr const char* stagePropName[]{ "vmaf_time_upstream", "vmaf_time_alloc", "vmaf_time_copy", "vmaf_time_read_pictures", "vmaf_time_flush" };
+
+// Latency histogram of one stage, updated without locks from every thread. Each power of two nanoseconds is split
+// into 4 buckets, so percentiles are accurate to about 12%.
+struct StageHistogram final {
+    std::array<std::atomic<uint64_t>, 256> buckets{};
+    std::atomic<uint64_t> count{};
+    std::atomic<uint64_t> totalNs{};
+};
+
+using StageStats = std::array<StageHistogram, stageCount>;
+
+// Stage times of the frame being produced by the current thread, for the optional frame properties.
+static thread_local std::array<uint64_t, stageCount> frameStageNs;
+
+static void recordStage(StageStats& stats, int stage, uint64_t ns) noexcept {
+    auto msb{ 0 };
+    while (ns >> (msb + 1))
+        msb++;
+
+    auto bucket{ ns < 4 ? ns : (msb - 1) * 4 + ((ns >> (msb - 2)) & 3) };
+
+    stats[stage].buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    stats[stage].count.fetch_add(1, std::memory_order_relaxed);
+    stats[stage].totalNs.fetch_add(ns, std::memory_order_relaxed);
+    frameStageNs[stage] += ns;
+}
+
+static double stagePercentileMs(const StageHistogram& histogram, double percentile) noexcept {
+    auto target{ static_cast<uint64_t>(std::ceil(histogram.count.load() * percentile / 100.0)) };
+    uint64_t seen{};
+
+    for (size_t i{}; i < histogram.buckets.size(); i++) {
+        if ((seen += histogram.buckets[i].load()) < std::max<uint64_t>(target, 1))
+            continue;
+
+        if (i < 4)
+            return i / 1e6;
+
+        // Middle of the bucket.
+        auto shift{ i / 4 - 1 };
+        return ((4 + i % 4) * 2 + 1) * (uint64_t{ 1 } << shift) / 2 / 1e6;
+    }
+
+    return 0.0;
+}
+
+static void logStageStats(const StageStats& stats, const std::string& filterName, VSCore* core, const VSAPI* vsapi) {
+    for (auto stage{ 0 }; stage < stageCount; stage++) {
+        auto& histogram{ stats[stage] };
+
+        if (!histogram.count)
+            continue;
+
+        auto msg{ filterName + ": " + stageName[stage] +
+                  ": count " + std::to_string(histogram.count.load()) +
+                  ", mean " + std::to_string(histogram.totalNs.load() / 1e6 / histogram.count.load()) + " ms" +
+                  ", p50 " + std::to_string(stagePercentileMs(histogram, 50.0)) + " ms" +
+                  ", p99 " + std::to_string(stagePercentileMs(histogram, 99.0)) + " ms" };
+        vsapi->logMessage(mtInformation, msg.c_str(), core);
+    }
+}
+
+static void setStageProps(VSMap* props, const VSAPI* vsapi) noexcept {
+    for (auto stage{ 0 }; stage < stageCount; stage++)
+        if (frameStageNs[stage])
+            vsapi->mapSetFloat(props, stagePropName[stage], frameStageNs[stage] / 1e6, maReplace);
+}
+
+// Adds the time spent in its scope to a stage. Does nothing, not even reading the clock, without instrumentation.
+class StageTimer final {
+public:
+    StageTimer(StageStats* stats, int stage) noexcept : stats{ stats }, stage{ stage } {
+        if (stats)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~StageTimer() {
+        if (stats)
+            recordStage(*stats, stage, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StageStats* stats;
+    int stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Records how long the frames requested in arInitial took to arrive, which is the time spent upstream (e.g. decoding).
+// The request time is kept in frameData in between, as steady_clock ticks stored in the pointer itself so that no
+// allocation is needed. 0 means the frame wasn't requested with instrument enabled.
+static void trackUpstream(StageStats* stats, int activationReason, void** frameData) noexcept {
+    if (!stats)
+        return;
+
+    auto now{ static_cast<uintptr_t>(std::chrono::steady_clock::now().time_since_epoch().count()) };
+    auto requested{ reinterpret_cast<uintptr_t>(*frameData) };
+
+    if (activationReason == arInitial) {
+        *frameData = reinterpret_cast<void*>(now);
+    } else if (requested) {
+        if (activationReason == arAllFramesReady) {
+            frameStageNs.fill(0);
+            recordStage(*stats, stageUpstream,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration{ now - requested }).count());
+        }
+
+        *frameData = nullptr;
+    }
+}
+
+// vmaf_read_pictures, timed as a flush when called without pictures.
+static int readPictures(VmafContext* vmaf, VmafPicture* ref, VmafPicture* dist, unsigned index, StageStats* stats) noexcept {
+    StageTimer timer{ stats, ref ? stageReadPictures : stageFlush };
+    return vmaf_read_pictures(vmaf, ref, dist, index);
+}
+
+// Coarse luma histogram, used by scene-adaptive CAMBI to tell whether a frame changed since the last scored one.
+// Samples above the nominal bit depth go into the top bin.
+using Signature = std::array<uint32_t, 64>;
+
+template<typename T>
+static void lumaSignature(Signature& signature, const VSFrame* frame, const Region& region, const VSAPI* vsapi) noexcept {
+    auto shift{ vsapi->getVideoFrameFormat(frame)->bitsPerSample - 6 };
+    auto stride{ vsapi->getStride(frame, 0) / static_cast<ptrdiff_t>(sizeof(T)) };
+    auto srcp{ reinterpret_cast<const T*>(vsapi->getReadPtr(frame, 0)) + region.top * stride + region.left };
+
+    signature.fill(0);
+
+    // Every 4th sample of every 4th row is plenty for a histogram.
+    for (auto y{ 0 }; y < region.height; y += 4)
+        for (auto x{ 0 }; x < region.width; x += 4)
+            signature[std::min(srcp[y * stride + x] >> shift, 63)]++;
+}
+
+// Fraction of samples that moved to another bin, from 0 (same histogram) to 1.
+static double signatureDistance(const Signature& a, const Signature& b) noexcept {
+    uint64_t diff{};
+    uint64_t total{};
+
+    for (size_t i{}; i < a.size(); i++) {
+        diff += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        total += a[i];
+    }
+
+    return total ? diff / 2.0 / total : 0.0;
+}
+
+struct QueuedPictures final {
+    VmafPicture ref;
+    VmafPicture dist;
+    bool ready;
+};
+
+// CPUs of a NUMA node, from its list in sysfs such as "0-15,32-47". Empty if the node doesn't exist or NUMA
+// information isn't available on this system.
+static std::vector<int> numaNodeCpus([[maybe_unused]] int node) {
+    std::vector<int> cpus;
+
+#ifdef __linux__
+    auto file{ std::fopen(("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist").c_str(), "r") };
+    if (!file)
+        return cpus;
+
+    char buffer[4096]{};
+    auto read{ !!std::fgets(buffer, sizeof(buffer), file) };
+    std::fclose(file);
+
+    auto p{ static_cast<const char*>(buffer) };
+    auto end{ buffer + std::strlen(buffer) };
+
+    while (read && p < end && *p != '\n') {
+        int first, last;
+        auto result{ std::from_chars(p, end, first) };
+        if (result.ec != std::errc{})
+            return {};
+
+        last = first;
+        p = result.ptr;
+
+        if (*p == '-') {
+            result = std::from_chars(p + 1, end, last);
+            if (result.ec != std::errc{})
+                return {};
+
+            p = result.ptr;
+        }
+
+        for (auto cpu{ first }; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            cpus.push_back(cpu);
+
+        if (*p == ',')
+            p++;
+    }
+#endif
+
+    return cpus;
+}
+
+// Threads inherit the CPU affinity of the thread starting them, so restricting the current thread while libvmaf
+// creates its workers pins them without libvmaf knowing about it. The previous affinity is restored on destruction.
+class AffinityScope final {
+public:
+    explicit AffinityScope([[maybe_unused]] const std::vector<int>& cpus) noexcept {
+#ifdef __linux__
+        if (cpus.empty() || pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved))
+            return;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto&& cpu : cpus)
+            CPU_SET(cpu, &set);
+
+        active = !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+
+    AffinityScope(const AffinityScope&) = delete;
+    AffinityScope& operator=(const AffinityScope&) = delete;
+
+    ~AffinityScope() {
+#ifdef __linux__
+        if (active)
+            pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+#endif
+    }
+
+private:
+#ifdef __linux__
+    cpu_set_t saved;
+    bool active{};
+#endif
+};
+
+// Every distorted clip after the first one is scored against the same reference by a context of its own.
+struct LadderRung final {
+    VSNode* distorted;
+    VmafContext* vmaf;
+    std::string logPath;
+    std::unique_ptr<Rescaler> rescaler;
+};
+
 struct VMAFData final {
     std::string filterName;
     VSNode* reference;
     VSNode* distorted;
+    std::unique_ptr<Rescaler> rescaler;
     const VSVideoInfo* vi;
     std::string logPath;
     VmafOutputFormat logFormat;
+    bool columnarLog;
     std::vector<VmafModel*> model;
     std::vector<VmafModelCollection*> modelCollection;
+    std::vector<const char*> modelScoreName;
+    std::vector<const char*> featureScoreName;
     VmafContext* vmaf;
+    std::vector<LadderRung> ladder;
     VmafPixelFormat pixelFormat;
     bool chroma;
+    int bitDepth;
+    Region region;
+    std::unique_ptr<StageStats> stats;
+    int subsample;
+    bool props;
+    int streamBatch;
+    bool streamSync;
+    std::FILE* logFile;
+    int streamNext;
+    int streamPending;
+    std::FILE* checkpointFile;
+    int resumeFrame;
+    std::vector<double> percentile;
+    std::vector<int> window;
+    std::string summaryPath;
+    int gateWindow;
+    double gateThreshold;
+    int gateAction;
+    bool gateStop;
+    std::vector<double> gateScores;
+    size_t gateCount;
+    int gateNext;
+    double gateSum;
+    bool gateTripped;
+    bool gateStopped;
+    std::string gateMessage;
+    int lastFrame;
+    bool adaptive;
+    double adaptiveThreshold;
+    int adaptiveInterval;
+    Signature adaptiveSignature;
+    int adaptiveSource;
+    int adaptiveScored;
+    std::vector<int> scoreSource;
+    int importedNext;
+    bool inOrder;
+    int readNext;
+    bool flushed;
+    int queueDepth;
+    int queueNext;
+    bool queueExit;
+    std::string queueError;
+    std::vector<int> queuePending;
+    int queueWaiting;
+    int queueThreads;
+    std::vector<QueuedPictures> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::thread feeder;
+    std::vector<int> numaCpus;
+    bool picturePool;
+    size_t poolHits;
+    size_t poolMisses;
+    size_t poolBytes;
+    std::vector<const void*> poolBuffers;
 };
 
-static const VSFrame* VS_CC vmafGetFrame(int n, int activationReason, void* instanceData, [[maybe_unused]] void** frameData,
-                                         VSFrameContext* frameCtx, [[maybe_unused]] VSCore* core, const VSAPI* vsapi) {
-    auto d{ static_cast<const VMAFData*>(instanceData) };
+// With queue_depth, frames are copied in parallel and parked in the queue slot of their frame number. This thread
+// is the only one calling vmaf_read_pictures, and it does so in frame order, so getFrame never waits for libvmaf.
+static void vmafFeed(VMAFData* d) {
+    std::unique_lock lock{ d->queueMutex };
+
+    while (true) {
+        auto& slot{ d->queue[d->queueNext % d->queueDepth] };
+        d->queueCond.wait(lock, [&] { return slot.ready || d->queueExit; });
+
+        if (!slot.ready)
+            break;
+
+        auto ref{ slot.ref };
+        auto dist{ slot.dist };
+        auto n{ d->queueNext++ };
+        slot.ready = false;
+        d->queueCond.notify_all();
+
+        lock.unlock();
+        auto err{ readPictures(d->vmaf, &ref, &dist, n, d->stats.get()) };
+        lock.lock();
+
+        if (err) {
+            d->queueError = "failed to read pictures";
+            d->queueCond.notify_all();
+            break;
+        }
+    }
+}
+
+// Frames skipped by subsample still have to be read to keep libvmaf's frame count, but only temporal extractors
+// look at them. Every model uses motion, so without a model their content is never used and needn't be fetched.
+static bool needsContent(const VMAFData* d, int n) noexcept {
+    return n >= d->resumeFrame && (!(n % d->subsample) || !d->model.empty());
+}
+
+// Scene-adaptive CAMBI only runs the extractor when the frame changed enough since the last scored one, or when the
+// last one is adaptive_interval frames old. Returns true when the frame is left out of libvmaf and its score is to be
+// carried forward.
+static bool reuseScore(VMAFData* d, int n, const VSFrame* frame, const VSAPI* vsapi) noexcept {
+    if (!d->adaptive || !needsContent(d, n))
+        return false;
+
+    Signature signature;
+
+    if (d->vi->format.bytesPerSample == 1)
+        lumaSignature<uint8_t>(signature, frame, d->region, vsapi);
+    else
+        lumaSignature<uint16_t>(signature, frame, d->region, vsapi);
+
+    if (d->adaptiveSource >= 0 &&
+        (!d->adaptiveInterval || n - d->adaptiveSource < d->adaptiveInterval) &&
+        signatureDistance(signature, d->adaptiveSignature) <= d->adaptiveThreshold) {
+        d->scoreSource[n] = d->adaptiveSource;
+        return true;
+    }
+
+    d->adaptiveSignature = signature;
+    d->adaptiveSource = n;
+    d->adaptiveScored++;
+    return false;
+}
+
+// With picture_pool, pictures read by the main context come from the pool libvmaf keeps for it, and go back there once
+// extraction is done with them. Every distinct buffer seen is counted once, which gives the memory held by the pool.
+static bool allocPictures(VMAFData* d, VmafPicture& ref, VmafPicture& dist, bool pooled) {
+    StageTimer timer{ d->stats.get(), stageAlloc };
+
+#ifdef HAVE_VMAF_PICTURE_POOL
+    if (pooled && d->picturePool) {
+        if (!vmaf_fetch_preallocated_picture(d->vmaf, &ref) && !vmaf_fetch_preallocated_picture(d->vmaf, &dist)) {
+            for (auto&& pic : { &ref, &dist }) {
+                if (std::find(d->poolBuffers.begin(), d->poolBuffers.end(), pic->data[0]) != d->poolBuffers.end())
+                    continue;
+
+                d->poolBuffers.push_back(pic->data[0]);
+                for (auto plane{ 0 }; plane < 3; plane++)
+                    d->poolBytes += pic->data[plane] ? pic->stride[plane] * pic->h[plane] : 0;
+            }
+
+            d->poolHits += 2;
+            return true;
+        }
+
+        vmaf_picture_unref(&ref);
+        vmaf_picture_unref(&dist);
+        ref = {};
+        dist = {};
+    }
+#endif
+
+    if (pooled && d->picturePool)
+        d->poolMisses += 2;
+
+    if (vmaf_picture_alloc(&ref, d->pixelFormat, d->bitDepth, d->region.width, d->region.height) ||
+        vmaf_picture_alloc(&dist, d->pixelFormat, d->bitDepth, d->region.width, d->region.height)) {
+        vmaf_picture_unref(&ref);
+        vmaf_picture_unref(&dist);
+        return false;
+    }
+
+    return true;
+}
+
+static bool copyPictures(VMAFData* d, VmafPicture& ref, VmafPicture& dist, const VSFrame* reference, const VSFrame* distorted,
+                         const Rescaler* rescaler, bool pooled, const VSAPI* vsapi) {
+    if (!allocPictures(d, ref, dist, pooled))
+        return false;
+
+    StageTimer timer{ d->stats.get(), stageCopy };
+
+    // libvmaf needs a picture pair of the same size, but CAMBI is a no-reference metric that only reads the distorted
+    // picture, so its reference picture is left as allocated.
+    if (d->filterName == "VMAF")
+        copyPicture(ref, reference, d->chroma ? d->vi->format.numPlanes : 1, d->region, vsapi);
+
+    if (rescaler)
+        rescalePicture(dist, distorted, d->chroma ? d->vi->format.numPlanes : 1, rescaler, vsapi);
+    else
+        copyPicture(dist, distorted, d->chroma ? d->vi->format.numPlanes : 1, d->region, vsapi);
+    return true;
+}
+
+// Scores are ordered as the models followed by the feature scores.
+static const char* scoreName(const VMAFData* d, size_t i) noexcept {
+    return i < d->modelScoreName.size() ? d->modelScoreName[i] : d->featureScoreName[i - d->modelScoreName.size()];
+}
+
+static bool flushFile(std::FILE* file, bool sync) {
+    if (std::fflush(file))
+        return false;
+
+#ifdef _WIN32
+    return !sync || !_commit(_fileno(file));
+#else
+    return !sync || !fsync(fileno(file));
+#endif
+}
+
+// A checkpoint holds the names of the scores, followed by one record per scored frame: the frame number and its
+// scores, in the order of the names. Only whole records are loaded back, so a file cut short by a crash still works.
+static constexpr char checkpointMagic[]{ 'V', 'M', 'A', 'F', 'C', 'K', 'P', '1' };
+
+static bool writeCheckpointHeader(const VMAFData* d) {
+    int header[]{ d->subsample, static_cast<int>(d->modelScoreName.size() + d->featureScoreName.size()) };
+
+    std::fwrite(checkpointMagic, sizeof(checkpointMagic), 1, d->checkpointFile);
+    std::fwrite(header, sizeof(header), 1, d->checkpointFile);
+
+    for (size_t i{}; i < d->modelScoreName.size() + d->featureScoreName.size(); i++) {
+        int length{ static_cast<int>(std::char_traits<char>::length(scoreName(d, i))) };
+        std::fwrite(&length, sizeof(length), 1, d->checkpointFile);
+        std::fwrite(scoreName(d, i), 1, length, d->checkpointFile);
+    }
+
+    return !std::ferror(d->checkpointFile);
+}
+
+static std::vector<std::pair<int, std::vector<double>>> readCheckpoint(const VMAFData* d, const std::string& path) {
+    auto file{ std::fopen(path.c_str(), "rb") };
+    if (!file)
+        throw "failed to open checkpoint: "s + path;
+
+    std::vector<std::pair<int, std::vector<double>>> records;
+    auto valid{ true };
+    char magic[sizeof(checkpointMagic)];
+    int header[2];
+
+    if (std::fread(magic, sizeof(magic), 1, file) != 1 || !std::equal(magic, magic + sizeof(magic), checkpointMagic) ||
+        std::fread(header, sizeof(header), 1, file) != 1 || header[0] != d->subsample ||
+        header[1] != static_cast<int>(d->modelScoreName.size() + d->featureScoreName.size()))
+        valid = false;
+
+    for (auto i{ 0 }; valid && i < header[1]; i++) {
+        int length;
+        std::string name;
+
+        if (std::fread(&length, sizeof(length), 1, file) != 1 || length < 0 || length > 256) {
+            valid = false;
+            break;
+        }
+
+        name.resize(length);
+        valid = std::fread(name.data(), 1, length, file) == static_cast<size_t>(length) && name == scoreName(d, i);
+    }
+
+    for (int n; valid && std::fread(&n, sizeof(n), 1, file) == 1;) {
+        std::vector<double> scores(header[1]);
+
+        if (std::fread(scores.data(), sizeof(double), scores.size(), file) != scores.size())
+            break;
+
+        if (n < 0 || n >= d->vi->numFrames || (!records.empty() && n <= records.back().first)) {
+            valid = false;
+            break;
+        }
+
+        records.emplace_back(n, std::move(scores));
+    }
+
+    std::fclose(file);
+
+    if (!valid)
+        throw "checkpoint doesn't match the current clip and options: "s + path;
+
+    return records;
+}
+
+// With stream, the log is written while frames are processed rather than by vmaf_write_output at the end. It holds
+// the same per-frame layout for model scores and requested feature scores, followed by their pooled scores.
+static bool writeLogHeader(const VMAFData* d) {
+    switch (d->logFormat) {
+    case VMAF_OUTPUT_FORMAT_XML:
+        std::fprintf(d->logFile, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<VMAF version=\"%s\">\n  <frames>\n", vmaf_version());
+        break;
+    case VMAF_OUTPUT_FORMAT_JSON:
+        std::fprintf(d->logFile, "{\n  \"version\": \"%s\",\n  \"frames\": [", vmaf_version());
+        break;
+    case VMAF_OUTPUT_FORMAT_CSV:
+        std::fprintf(d->logFile, "Frame,");
+        for (auto&& name : d->modelScoreName)
+            std::fprintf(d->logFile, "%s,", name);
+        for (auto&& name : d->featureScoreName)
+            std::fprintf(d->logFile, "%s,", name);
+        std::fprintf(d->logFile, "\n");
+        break;
+    default:
+        break;
+    }
+
+    return !std::ferror(d->logFile);
+}
+
+static bool writeLogFrame(VMAFData* d, int n, const std::vector<double>& scores) {
+    switch (d->logFormat) {
+    case VMAF_OUTPUT_FORMAT_XML:
+        std::fprintf(d->logFile, "    <frame frameNum=\"%d\" ", n);
+        for (size_t i{}; i < scores.size(); i++)
+            std::fprintf(d->logFile, "%s=\"%.6f\" ", scoreName(d, i), scores[i]);
+        std::fprintf(d->logFile, "/>\n");
+        break;
+    case VMAF_OUTPUT_FORMAT_JSON:
+        std::fprintf(d->logFile, "%s\n    {\n      \"frameNum\": %d,\n      \"metrics\": {", d->streamNext ? "," : "", n);
+        for (size_t i{}; i < scores.size(); i++)
+            std::fprintf(d->logFile, "%s\n        \"%s\": %.6f", i ? "," : "", scoreName(d, i), scores[i]);
+        std::fprintf(d->logFile, "\n      }\n    }");
+        break;
+    case VMAF_OUTPUT_FORMAT_CSV:
+        std::fprintf(d->logFile, "%d,", n);
+        for (auto&& score : scores)
+            std::fprintf(d->logFile, "%.6f,", score);
+        std::fprintf(d->logFile, "\n");
+        break;
+    case VMAF_OUTPUT_FORMAT_SUB:
+        std::fprintf(d->logFile, "{%d}{%d}frame: %d|", n, n + 1, n);
+        for (size_t i{}; i < scores.size(); i++)
+            std::fprintf(d->logFile, "%s: %.6f|", scoreName(d, i), scores[i]);
+        std::fprintf(d->logFile, "\n");
+        break;
+    default:
+        break;
+    }
+
+    if (d->checkpointFile) {
+        std::fwrite(&n, sizeof(n), 1, d->checkpointFile);
+        std::fwrite(scores.data(), sizeof(double), scores.size(), d->checkpointFile);
+    }
+
+    d->streamNext = n + 1;
+
+    if (++d->streamPending == d->streamBatch) {
+        d->streamPending = 0;
+
+        if (!flushFile(d->logFile, d->streamSync) || (d->checkpointFile && !flushFile(d->checkpointFile, d->streamSync)))
+            return false;
+    }
+
+    return !std::ferror(d->logFile) && !(d->checkpointFile && std::ferror(d->checkpointFile));
+}
+
+// Pools the per-frame scores of score i by the requested percentiles and by the lowest mean over each requested
+// window length, in addition to libvmaf's pooling methods.
+static bool poolScores(const VMAFData* d, size_t i, std::vector<std::pair<std::string, double>>& pooled) {
+    std::vector<double> scores;
+
+    for (auto n{ 0 }; n <= d->lastFrame; n += d->subsample) {
+        if (i < d->model.size() ? vmaf_score_at_index(d->vmaf, d->model[i], &scores.emplace_back(), n)
+                                : vmaf_feature_score_at_index(d->vmaf, scoreName(d, i), &scores.emplace_back(), n))
+            return false;
+    }
+
+    if (scores.empty())
+        return false;
+
+    for (auto w : d->window) {
+        auto length{ std::min(static_cast<size_t>(w), scores.size()) };
+        auto sum{ 0.0 };
+
+        for (size_t n{}; n < length; n++)
+            sum += scores[n];
+
+        auto lowest{ sum };
+
+        for (auto n{ length }; n < scores.size(); n++) {
+            sum += scores[n] - scores[n - length];
+            lowest = std::min(lowest, sum);
+        }
+
+        pooled.emplace_back("low_" + std::to_string(w), lowest / length);
+    }
+
+    for (auto p : d->percentile) {
+        std::array<char, 32> str{};
+        auto index{ static_cast<size_t>(p / 100.0 * (scores.size() - 1)) };
+
+        std::nth_element(scores.begin(), scores.begin() + index, scores.end());
+        pooled.emplace_back("p" + std::string(str.data(), std::to_chars(str.data(), str.data() + str.size(), p).ptr), scores[index]);
+    }
+
+    return true;
+}
+
+static constexpr VmafPoolingMethod poolMethod[]{ VMAF_POOL_METHOD_MIN, VMAF_POOL_METHOD_MAX, VMAF_POOL_METHOD_MEAN, VMAF_POOL_METHOD_HARMONIC_MEAN };
+static constexpr const char* poolName[]{ "min", "max", "mean", "harmonic_mean" };
+
+static bool writeLogFooter(const VMAFData* d, const std::vector<std::vector<std::pair<std::string, double>>>& pooled) {
+    switch (d->logFormat) {
+    case VMAF_OUTPUT_FORMAT_XML:
+        std::fprintf(d->logFile, "  </frames>\n  <pooled_metrics>\n");
+        break;
+    case VMAF_OUTPUT_FORMAT_JSON:
+        std::fprintf(d->logFile, "\n  ],\n  \"pooled_metrics\": {");
+        break;
+    default:
+        return !std::ferror(d->logFile);
+    }
+
+    for (size_t i{}; i < d->modelScoreName.size() + d->featureScoreName.size(); i++) {
+        auto isModel{ i < d->modelScoreName.size() };
+        auto name{ scoreName(d, i) };
+
+        if (d->logFormat == VMAF_OUTPUT_FORMAT_XML)
+            std::fprintf(d->logFile, "    <metric name=\"%s\" ", name);
+        else
+            std::fprintf(d->logFile, "%s\n    \"%s\": {", i ? "," : "", name);
+
+        for (auto j{ 0 }; j < 4; j++) {
+            double score;
+
+            if (isModel ? vmaf_score_pooled(d->vmaf, d->model[i], poolMethod[j], &score, 0, d->lastFrame)
+                        : vmaf_feature_score_pooled(d->vmaf, name, poolMethod[j], &score, 0, d->lastFrame))
+                return false;
+
+            if (d->logFormat == VMAF_OUTPUT_FORMAT_XML)
+                std::fprintf(d->logFile, "%s=\"%.6f\" ", poolName[j], score);
+            else
+                std::fprintf(d->logFile, "%s\n      \"%s\": %.6f", j ? "," : "", poolName[j], score);
+        }
+
+        for (size_t j{}; i < pooled.size() && j < pooled[i].size(); j++) {
+            if (d->logFormat == VMAF_OUTPUT_FORMAT_XML)
+                std::fprintf(d->logFile, "%s=\"%.6f\" ", pooled[i][j].first.c_str(), pooled[i][j].second);
+            else
+                std::fprintf(d->logFile, ",\n      \"%s\": %.6f", pooled[i][j].first.c_str(), pooled[i][j].second);
+        }
+
+        std::fprintf(d->logFile, d->logFormat == VMAF_OUTPUT_FORMAT_XML ? "/>\n" : "\n    }");
+    }
+
+    std::fprintf(d->logFile, d->logFormat == VMAF_OUTPUT_FORMAT_XML ? "  </pooled_metrics>\n</VMAF>\n" : "\n  }\n}\n");
+    return !std::ferror(d->logFile);
+}
+
+// The summary holds the pooled scores of libvmaf's methods together with the percentile and window ones, as JSON
+// independent of the log format, so that they are machine-readable without stream.
+static bool writeSummary(const VMAFData* d, const std::vector<std::vector<std::pair<std::string, double>>>& pooled) {
+    auto file{ std::fopen(d->summaryPath.c_str(), "w") };
+    if (!file)
+        return false;
+
+    std::fprintf(file, "{\n  \"version\": \"%s\",\n  \"frames\": %d,\n  \"pooled_metrics\": {", vmaf_version(), d->lastFrame + 1);
+
+    for (size_t i{}; i < d->modelScoreName.size() + d->featureScoreName.size(); i++) {
+        auto isModel{ i < d->modelScoreName.size() };
+        auto name{ scoreName(d, i) };
+
+        std::fprintf(file, "%s\n    \"%s\": {", i ? "," : "", name);
+
+        for (auto j{ 0 }; j < 4; j++) {
+            double score;
+
+            if (isModel ? vmaf_score_pooled(d->vmaf, d->model[i], poolMethod[j], &score, 0, d->lastFrame)
+                        : vmaf_feature_score_pooled(d->vmaf, name, poolMethod[j], &score, 0, d->lastFrame)) {
+                std::fclose(file);
+                return false;
+            }
+
+            std::fprintf(file, "%s\n      \"%s\": %.6f", j ? "," : "", poolName[j], score);
+        }
+
+        for (size_t j{}; i < pooled.size() && j < pooled[i].size(); j++)
+            std::fprintf(file, ",\n      \"%s\": %.6f", pooled[i][j].first.c_str(), pooled[i][j].second);
+
+        std::fprintf(file, "\n    }");
+    }
+
+    std::fprintf(file, "\n  }\n}\n");
+
+    auto failed{ std::ferror(file) };
+    return !std::fclose(file) && !failed;
+}
+
+// With log_format 4, the log is a columnar binary file meant to be memory-mapped, e.g. by LoadScores. All fields are
+// native-endian:
+//   magic "VSVMAFC1", uint32 number of frames, uint32 number of scores
+//   for each score: uint32 name length, followed by the name without terminator
+//   zero padding to a multiple of 8 bytes
+//   for each score in the same order: one double per frame, NaN for frames without a score
+static constexpr char columnarMagic[8]{ 'V', 'S', 'V', 'M', 'A', 'F', 'C', '1' };
+
+static bool writeColumnarLog(const VMAFData* d, VmafContext* vmaf, const char* path) {
+    auto file{ std::fopen(path, "wb") };
+    if (!file)
+        return false;
+
+    auto numScores{ d->modelScoreName.size() + d->featureScoreName.size() };
+    uint32_t header[]{ static_cast<uint32_t>(d->vi->numFrames), static_cast<uint32_t>(numScores) };
+    auto offset{ sizeof(columnarMagic) + sizeof(header) };
+
+    std::fwrite(columnarMagic, 1, sizeof(columnarMagic), file);
+    std::fwrite(header, sizeof(uint32_t), 2, file);
+
+    for (size_t i{}; i < numScores; i++) {
+        auto name{ scoreName(d, i) };
+        auto length{ static_cast<uint32_t>(std::strlen(name)) };
+
+        std::fwrite(&length, sizeof(length), 1, file);
+        std::fwrite(name, 1, length, file);
+        offset += sizeof(length) + length;
+    }
+
+    static constexpr char padding[8]{};
+    std::fwrite(padding, 1, (8 - offset % 8) % 8, file);
+
+    std::vector<double> column(d->vi->numFrames);
+
+    // Frames skipped by subsample or left out by the gate are never asked from libvmaf, as the model prediction logs an
+    // error for every frame it has no features for.
+    for (size_t i{}; i < numScores; i++) {
+        for (auto n{ 0 }; n < d->vi->numFrames; n++) {
+            if (n % d->subsample || n > d->lastFrame ||
+                (i < d->model.size() ? vmaf_score_at_index(vmaf, d->model[i], &column[n], n)
+                                     : vmaf_feature_score_at_index(vmaf, scoreName(d, i), &column[n], n)))
+                column[n] = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        std::fwrite(column.data(), sizeof(double), column.size(), file);
+    }
+
+    auto failed{ std::ferror(file) };
+    return !std::fclose(file) && !failed;
+}
+
+static const VSFrame* VS_CC vmafGetFrame(int n, int activationReason, void* instanceData, void** frameData,
+                                         VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi) {
+    auto d{ static_cast<VMAFData*>(instanceData) };
+    trackUpstream(d->stats.get(), activationReason, frameData);
 
     if (activationReason == arInitial) {
-        vsapi->requestFrameFilter(n, d->reference, frameCtx);
-        if (d->filterName == "VMAF")
-            vsapi->requestFrameFilter(n, d->distorted, frameCtx);
+        if (d->queueDepth) {
+            std::lock_guard lock{ d->queueMutex };
+            d->queuePending.push_back(n);
+        }
+
+        // Once the gate stopped scoring, the reference is all that is needed.
+        if (d->gateStopped) {
+            vsapi->requestFrameFilter(n, d->reference, frameCtx);
+            return nullptr;
+        }
+
+        for (auto i{ n }; i <= (d->inOrder ? std::min(n + 1, d->vi->numFrames - 1) : n); i++) {
+            if (i == n || i >= d->resumeFrame)
+                vsapi->requestFrameFilter(i, d->reference, frameCtx);
+            if (d->filterName == "VMAF" && needsContent(d, i))
+                vsapi->requestFrameFilter(i, d->distorted, frameCtx);
+            for (auto&& r : d->ladder)
+                if (needsContent(d, i))
+                    vsapi->requestFrameFilter(i, r.distorted, frameCtx);
+        }
     } else if (activationReason == arAllFramesReady) {
+        if (d->gateStopped) {
+            auto reference{ vsapi->getFrameFilter(n, d->reference, frameCtx) };
+            auto dst{ vsapi->copyFrame(reference, core) };
+            vsapi->mapSetInt(vsapi->getFramePropertiesRW(dst), "vmaf_gate", 1, maReplace);
+            vsapi->freeFrame(reference);
+            return dst;
+        }
+
         auto reference{ vsapi->getFrameFilter(n, d->reference, frameCtx) };
-        auto distorted{ d->filterName == "VMAF" ? vsapi->getFrameFilter(n, d->distorted, frameCtx) : vsapi->addFrameRef(reference) };
+        auto distorted{ d->filterName == "VMAF" && needsContent(d, n) ? vsapi->getFrameFilter(n, d->distorted, frameCtx) : vsapi->addFrameRef(reference) };
+        VSFrame* dst{};
+
+        VmafPicture ref{};
+        VmafPicture dist{};
+
+        try {
+            if (d->queueDepth) {
+                std::unique_lock lock{ d->queueMutex };
+
+                // A frame beyond the queue may only wait while the feeder is sure to move on: the frame it needs next
+                // is already queued, or it was requested and at least one thread is left to produce it. A frame that was
+                // never requested (e.g. when starting in the middle of the clip) would otherwise hang the filter.
+                auto pending{ [&](int i) { return std::find(d->queuePending.begin(), d->queuePending.end(), i) != d->queuePending.end(); } };
+
+                d->queueWaiting++;
+                d->queueCond.wait(lock, [&] {
+                    return n < d->queueNext + d->queueDepth || !d->queueError.empty() ||
+                           !(d->queue[d->queueNext % d->queueDepth].ready || (pending(d->queueNext) && d->queueWaiting < d->queueThreads));
+                });
+                d->queueWaiting--;
+
+                if (!d->queueError.empty())
+                    throw d->queueError.c_str();
+
+                if (n >= d->queueNext + d->queueDepth)
+                    throw "frame is too far ahead of the frames not yet scored, request frames in order or raise queue_depth";
+
+                if (n < d->queueNext || d->queue[n % d->queueDepth].ready) {
+                    d->queuePending.erase(std::find(d->queuePending.begin(), d->queuePending.end(), n));
+                    d->queueCond.notify_all();
 
-        VmafPicture ref;
-        VmafPicture dist;
+                    vsapi->freeFrame(distorted);
+                    return reference;
+                }
+            }
+
+            if (d->inOrder && n > d->readNext)
+                throw "frames must be requested in order when props, stream, gate or adaptive is enabled";
+
+            if ((!d->inOrder || n == d->readNext) && n >= d->resumeFrame && !reuseScore(d, n, distorted, vsapi)) {
+                if (!(needsContent(d, n) ? copyPictures(d, ref, dist, reference, distorted, d->rescaler.get(), true, vsapi) : allocPictures(d, ref, dist, true)))
+                    throw "failed to allocate picture";
+
+                if (d->queueDepth) {
+                    std::lock_guard lock{ d->queueMutex };
+
+                    if (auto& slot{ d->queue[n % d->queueDepth] }; !slot.ready) {
+                        slot = { ref, dist, true };
+                    } else {
+                        vmaf_picture_unref(&ref);
+                        vmaf_picture_unref(&dist);
+                    }
+
+                    d->queuePending.erase(std::find(d->queuePending.begin(), d->queuePending.end(), n));
+                    d->queueCond.notify_all();
+                } else if (readPictures(d->vmaf, &ref, &dist, n, d->stats.get())) {
+                    throw "failed to read pictures";
+                }
+
+                for (auto&& r : d->ladder) {
+                    auto rung{ needsContent(d, n) ? vsapi->getFrameFilter(n, r.distorted, frameCtx) : nullptr };
+                    auto copied{ rung ? copyPictures(d, ref, dist, reference, rung, r.rescaler.get(), false, vsapi) : allocPictures(d, ref, dist, false) };
+
+                    vsapi->freeFrame(rung);
+
+                    if (!copied)
+                        throw "failed to allocate picture";
+
+                    if (readPictures(r.vmaf, &ref, &dist, n, d->stats.get()))
+                        throw "failed to read pictures";
+                }
+            }
+
+            if (d->inOrder) {
+                if (n == d->readNext && n >= d->resumeFrame)
+                    d->readNext = n + 1;
+
+                // Some features of frame n (e.g. motion) are only final once frame n + 1 has been read.
+                if (n + 1 == d->readNext && d->readNext < d->vi->numFrames) {
+                    auto nextReference{ vsapi->getFrameFilter(n + 1, d->reference, frameCtx) };
+                    auto nextDistorted{ d->filterName == "VMAF" && needsContent(d, n + 1) ? vsapi->getFrameFilter(n + 1, d->distorted, frameCtx) : vsapi->addFrameRef(nextReference) };
+                    auto reused{ reuseScore(d, n + 1, nextDistorted, vsapi) };
+                    auto copied{ reused || (needsContent(d, n + 1) ? copyPictures(d, ref, dist, nextReference, nextDistorted, d->rescaler.get(), true, vsapi) : allocPictures(d, ref, dist, true)) };
+
+                    vsapi->freeFrame(nextReference);
+                    vsapi->freeFrame(nextDistorted);
+
+                    if (!copied)
+                        throw "failed to allocate picture";
+
+                    if (!reused && readPictures(d->vmaf, &ref, &dist, n + 1, d->stats.get()))
+                        throw "failed to read pictures";
+
+                    d->readNext++;
+                }
+
+                if (d->readNext == d->vi->numFrames && !d->flushed) {
+                    if (readPictures(d->vmaf, nullptr, nullptr, 0, d->stats.get()))
+                        throw "failed to flush context";
+
+                    d->flushed = true;
+                }
+
+                // Scores of frames left out by scene-adaptive CAMBI are carried forward now that the one they come from is final.
+                // Frames requested again already have them, and libvmaf refuses a second import.
+                if (d->adaptive && needsContent(d, n) && n >= d->importedNext) {
+                    d->importedNext = n + 1;
+
+                    auto source{ d->scoreSource[n] };
+                    double score{};
+
+                    if ((source != n && (vmaf_feature_score_at_index(d->vmaf, "cambi", &score, source) || vmaf_import_feature_score(d->vmaf, "cambi", score, n))) ||
+                        vmaf_import_feature_score(d->vmaf, "cambi_interpolated", source != n, n))
+                        throw "failed to carry CAMBI score forward";
+                }
+
+                // Frames skipped by subsample have no scores.
+                std::vector<double> scores;
+
+                for (size_t i{}; i < d->model.size() && !(n % d->subsample); i++) {
+                    if (vmaf_score_at_index(d->vmaf, d->model[i], &scores.emplace_back(), n))
+                        throw "failed to fetch VMAF score";
+                }
+
+                for (size_t i{}; i < d->featureScoreName.size() && !(n % d->subsample); i++) {
+                    if (vmaf_feature_score_at_index(d->vmaf, d->featureScoreName[i], &scores.emplace_back(), n))
+                        throw "failed to fetch feature score";
+                }
+
+                if (d->logFile && !scores.empty() && n >= d->streamNext && !writeLogFrame(d, n, scores))
+                    throw "failed to write VMAF stats";
+
+                // The gate watches the mean of the first score over the last gate_window sampled frames. Frames requested
+                // again are already in the window.
+                if (d->gateWindow && !scores.empty() && !d->gateTripped && n >= d->gateNext) {
+                    d->gateNext = n + 1;
+
+                    auto& slot{ d->gateScores[d->gateCount++ % d->gateWindow] };
+                    d->gateSum += scores[0] - slot;
+                    slot = scores[0];
+
+                    if (d->gateCount >= static_cast<size_t>(d->gateWindow) && d->gateSum / d->gateWindow < d->gateThreshold) {
+                        d->gateTripped = true;
+                        d->gateStopped = d->gateStop || !d->gateAction;
+
+                        if (d->gateStopped)
+                            d->lastFrame = d->readNext - 1;
+
+                        d->gateMessage = "mean "s + scoreName(d, 0) + " of " + std::to_string(d->gateSum / d->gateWindow) + " over the " +
+                                         std::to_string(d->gateWindow) + " frames up to frame " + std::to_string(n) + " is below the gate";
+
+                        if (!d->gateAction)
+                            throw d->gateMessage.c_str();
+
+                        vsapi->logMessage(mtWarning, (d->filterName + ": " + d->gateMessage).c_str(), core);
+                    }
+                }
+
+                if (d->props || d->gateAction) {
+                    dst = vsapi->copyFrame(reference, core);
+                    auto props{ vsapi->getFramePropertiesRW(dst) };
+
+                    for (size_t i{}; i < scores.size() && d->props; i++)
+                        vsapi->mapSetFloat(props, scoreName(d, i), scores[i], maReplace);
+
+                    if (d->stats && d->props)
+                        setStageProps(props, vsapi);
+
+                    if (d->gateAction)
+                        vsapi->mapSetInt(props, "vmaf_gate", d->gateTripped, maReplace);
+                }
+            }
+        } catch (const char* error) {
+            vsapi->setFilterError((d->filterName + ": " + error).c_str(), frameCtx);
+
+            // The slot of this frame stays empty, so the feeder can't go past it anymore. Every frame waiting for the
+            // queue has to fail as well.
+            if (d->queueDepth) {
+                std::lock_guard lock{ d->queueMutex };
+
+                if (d->queueError.empty())
+                    d->queueError = error;
+
+                d->queueCond.notify_all();
+            }
+
+            vsapi->freeFrame(reference);
+            vsapi->freeFrame(distorted);
+            vsapi->freeFrame(dst);
+
+            vmaf_picture_unref(&ref);
+            vmaf_picture_unref(&dist);
+
+            return nullptr;
+        }
+
+        if (dst) {
+            vsapi->freeFrame(reference);
+            vsapi->freeFrame(distorted);
+            return dst;
+        }
+
+        vsapi->freeFrame(distorted);
+        return reference;
+    } else if (activationReason == arError) {
+        // An upstream frame failed, so this frame is never queued and the feeder can't go past it.
+        if (d->queueDepth) {
+            std::lock_guard lock{ d->queueMutex };
+
+            if (auto it{ std::find(d->queuePending.begin(), d->queuePending.end(), n) }; it != d->queuePending.end())
+                d->queuePending.erase(it);
+
+            if (d->queueError.empty())
+                d->queueError = "failed to get frame " + std::to_string(n) + " from upstream";
+
+            d->queueCond.notify_all();
+        }
+    }
+
+    return nullptr;
+}
+
+static void VS_CC vmafFree(void* instanceData, VSCore* core, const VSAPI* vsapi) {
+    auto d{ static_cast<VMAFData*>(instanceData) };
+
+    vsapi->freeNode(d->reference);
+    vsapi->freeNode(d->distorted);
+    for (auto&& r : d->ladder)
+        vsapi->freeNode(r.distorted);
+
+    auto logMessage = [&](const char* msg) noexcept {
+        vsapi->logMessage(mtCritical, (d->filterName + ": " + msg).c_str(), core);
+    };
+
+    if (d->feeder.joinable()) {
+        {
+            std::lock_guard lock{ d->queueMutex };
+            d->queueExit = true;
+        }
+
+        d->queueCond.notify_all();
+        d->feeder.join();
+
+        auto stranded{ 0 };
+
+        for (auto&& slot : d->queue) {
+            if (slot.ready) {
+                vmaf_picture_unref(&slot.ref);
+                vmaf_picture_unref(&slot.dist);
+                stranded++;
+            }
+        }
+
+        if (stranded)
+            vsapi->logMessage(mtWarning,
+                              (d->filterName + ": " + std::to_string(stranded) + " queued frames were never scored because frame " +
+                               std::to_string(d->queueNext) + " was never requested").c_str(),
+                              core);
+    }
+
+    if (!d->flushed && readPictures(d->vmaf, nullptr, nullptr, 0, d->stats.get()))
+        logMessage("failed to flush context");
+
+    for (auto&& m : d->model)
+        if (double score; vmaf_score_pooled(d->vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->lastFrame))
+            logMessage("failed to generate pooled VMAF score");
+
+    for (auto&& m : d->modelCollection)
+        if (VmafModelCollectionScore score; vmaf_score_pooled_model_collection(d->vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->lastFrame))
+            logMessage("failed to generate pooled VMAF score");
+
+    for (auto&& r : d->ladder) {
+        if (readPictures(r.vmaf, nullptr, nullptr, 0, d->stats.get()))
+            logMessage("failed to flush context");
+
+        for (auto&& m : d->model)
+            if (double score; vmaf_score_pooled(r.vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->vi->numFrames - 1))
+                logMessage("failed to generate pooled VMAF score");
+
+        for (auto&& m : d->modelCollection)
+            if (VmafModelCollectionScore score; vmaf_score_pooled_model_collection(r.vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->vi->numFrames - 1))
+                logMessage("failed to generate pooled VMAF score");
 
-        try {
-            if (vmaf_picture_alloc(&ref, d->pixelFormat, d->vi->format.bitsPerSample, d->vi->width, d->vi->height) ||
-                vmaf_picture_alloc(&dist, d->pixelFormat, d->vi->format.bitsPerSample, d->vi->width, d->vi->height))
-                throw "failed to allocate picture";
-
-            for (auto plane{ 0 }; plane < d->vi->format.numPlanes; plane++) {
-                if (plane && !d->chroma)
-                    break;
-
-                vsh::bitblt(ref.data[plane],
-                            ref.stride[plane],
-                            vsapi->getReadPtr(reference, plane),
-                            vsapi->getStride(reference, plane),
-                            vsapi->getFrameWidth(reference, plane) * d->vi->format.bytesPerSample,
-                            vsapi->getFrameHeight(reference, plane));
-
-                vsh::bitblt(dist.data[plane],
-                            dist.stride[plane],
-                            vsapi->getReadPtr(distorted, plane),
-                            vsapi->getStride(distorted, plane),
-                            vsapi->getFrameWidth(distorted, plane) * d->vi->format.bytesPerSample,
-                            vsapi->getFrameHeight(distorted, plane));
-            }
+        if (d->columnarLog ? !writeColumnarLog(d, r.vmaf, r.logPath.c_str()) : !!vmaf_write_output(r.vmaf, r.logPath.c_str(), d->logFormat))
+            logMessage("failed to write VMAF stats");
+    }
 
-            if (vmaf_read_pictures(d->vmaf, &ref, &dist, n))
-                throw "failed to read pictures";
-        } catch (const char* error) {
-            vsapi->setFilterError((d->filterName + ": " + error).c_str(), frameCtx);
+    // Report how far the subsampled mean can be trusted, as a normal-approximation 95% confidence interval.
+    for (size_t i{}; i < d->model.size() && d->subsample > 1; i++) {
+        auto sum{ 0.0 };
+        auto sumSquares{ 0.0 };
+        auto count{ 0 };
 
-            vsapi->freeFrame(reference);
-            vsapi->freeFrame(distorted);
+        for (auto n{ 0 }; n <= d->lastFrame; n += d->subsample) {
+            double score;
 
-            vmaf_picture_unref(&ref);
-            vmaf_picture_unref(&dist);
+            if (vmaf_score_at_index(d->vmaf, d->model[i], &score, n))
+                break;
 
-            return nullptr;
+            sum += score;
+            sumSquares += score * score;
+            count++;
         }
 
-        vsapi->freeFrame(distorted);
-        return reference;
+        if (count < 2)
+            continue;
+
+        auto mean{ sum / count };
+        auto stddev{ std::sqrt(std::max(sumSquares - sum * mean, 0.0) / (count - 1)) };
+
+        vsapi->logMessage(mtInformation,
+                          (d->filterName + ": " + d->modelScoreName[i] + " mean " + std::to_string(mean) + " +/- " + std::to_string(1.96 * stddev / std::sqrt(count)) +
+                           " (95% confidence over " + std::to_string(count) + " sampled frames)").c_str(),
+                          core);
     }
 
-    return nullptr;
-}
+    if (d->picturePool)
+        vsapi->logMessage(mtInformation,
+                          (d->filterName + ": picture pool: " + std::to_string(d->poolHits) + " of " + std::to_string(d->poolHits + d->poolMisses) +
+                           " pictures served from the pool, " + std::to_string(d->poolBytes) + " bytes resident in " +
+                           std::to_string(d->poolBuffers.size()) + " buffers").c_str(),
+                          core);
+
+    if (d->adaptive) {
+        auto carried{ 0 };
+        for (auto n{ 0 }; n <= d->lastFrame; n++)
+            carried += d->scoreSource[n] != n;
+
+        vsapi->logMessage(mtInformation,
+                          (d->filterName + ": adaptive: extractor ran on " + std::to_string(d->adaptiveScored) + " frames, score carried forward on " +
+                           std::to_string(carried) + " frames").c_str(),
+                          core);
+    }
 
-static void VS_CC vmafFree(void* instanceData, VSCore* core, const VSAPI* vsapi) {
-    auto d{ static_cast<VMAFData*>(instanceData) };
+    std::vector<std::vector<std::pair<std::string, double>>> pooled;
 
-    vsapi->freeNode(d->reference);
-    vsapi->freeNode(d->distorted);
+    for (size_t i{}; i < d->modelScoreName.size() + d->featureScoreName.size() && (!d->percentile.empty() || !d->window.empty()); i++) {
+        if (!poolScores(d, i, pooled.emplace_back())) {
+            logMessage("failed to generate pooled score");
+            pooled.clear();
+            break;
+        }
 
-    static auto logMessage = [&](const char* msg) noexcept {
-        vsapi->logMessage(mtCritical, (d->filterName + ": " + msg).c_str(), core);
-    };
+        auto msg{ d->filterName + ": " + scoreName(d, i) };
+        for (auto&& [name, score] : pooled.back())
+            msg += " " + name + " " + std::to_string(score);
 
-    if (vmaf_read_pictures(d->vmaf, nullptr, nullptr, 0))
-        logMessage("failed to flush context");
+        vsapi->logMessage(mtInformation, msg.c_str(), core);
+    }
 
-    for (auto&& m : d->model)
-        if (double score; vmaf_score_pooled(d->vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->vi->numFrames - 1))
-            logMessage("failed to generate pooled VMAF score");
+    if (d->checkpointFile && std::fclose(d->checkpointFile))
+        logMessage("failed to write checkpoint");
 
-    for (auto&& m : d->modelCollection)
-        if (VmafModelCollectionScore score; vmaf_score_pooled_model_collection(d->vmaf, m, VMAF_POOL_METHOD_MEAN, &score, 0, d->vi->numFrames - 1))
-            logMessage("failed to generate pooled VMAF score");
+    if (!d->summaryPath.empty() && !writeSummary(d, pooled))
+        logMessage("failed to write summary");
 
-    if (vmaf_write_output(d->vmaf, d->logPath.c_str(), d->logFormat))
+    if (d->logFile) {
+        if (!writeLogFooter(d, pooled) || std::fclose(d->logFile))
+            logMessage("failed to write VMAF stats");
+    } else if (d->columnarLog ? !writeColumnarLog(d, d->vmaf, d->logPath.c_str()) : !!vmaf_write_output(d->vmaf, d->logPath.c_str(), d->logFormat)) {
         logMessage("failed to write VMAF stats");
+    }
 
     for (auto&& m : d->model)
         vmaf_model_destroy(m);
     for (auto&& m : d->modelCollection)
         vmaf_model_collection_destroy(m);
     vmaf_close(d->vmaf);
+    for (auto&& r : d->ladder)
+        vmaf_close(r.vmaf);
+
+    if (d->stats)
+        logStageStats(*d->stats, d->filterName, core, vsapi);
 
     delete d;
 }
@@ -160,6 +1619,9 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
         if (d->filterName == "VMAF") {
             d->reference = vsapi->mapGetNode(in, "reference", 0, nullptr);
             d->distorted = vsapi->mapGetNode(in, "distorted", 0, nullptr);
+
+            for (auto i{ 1 }; i < vsapi->mapNumElements(in, "distorted"); i++)
+                d->ladder.push_back({ vsapi->mapGetNode(in, "distorted", i, nullptr), nullptr, {}, {} });
         } else {
             d->reference = vsapi->mapGetNode(in, "clip", 0, nullptr);
         }
@@ -186,32 +1648,230 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
               (d->vi->format.subSamplingW == 0 && d->vi->format.subSamplingH == 0)))
             throw "only 420/422/444 chroma subsampling is supported"s;
 
+        d->bitDepth = vsapi->mapGetIntSaturated(in, "bit_depth", 0, &err);
+        if (err)
+            d->bitDepth = d->vi->format.bitsPerSample;
+
+        if (d->bitDepth != d->vi->format.bitsPerSample && ((d->bitDepth != 10 && d->bitDepth != 12) || d->bitDepth > d->vi->format.bitsPerSample))
+            throw "bit_depth must be 10 or 12, and lower than the bit depth of the clips"s;
+
+        if (auto error{ parseRegion(d->region, in, d->reference, d->filterName.c_str(), core, vsapi) })
+            throw std::string{ error };
+
         d->logPath = vsapi->mapGetData(in, "log_path", 0, nullptr);
+
+        if (vsapi->mapNumElements(in, "log_path") != static_cast<int>(d->ladder.size()) + 1)
+            throw "log_path must have one entry per distorted clip"s;
+
+        for (size_t i{}; i < d->ladder.size(); i++)
+            d->ladder[i].logPath = vsapi->mapGetData(in, "log_path", i + 1, nullptr);
+
         auto logFormat{ vsapi->mapGetIntSaturated(in, "log_format", 0, &err) };
 
-        if (logFormat < 0 || logFormat > 3)
-            throw "log_format must be 0, 1, 2, or 3"s;
+        if (logFormat < 0 || logFormat > 4)
+            throw "log_format must be 0, 1, 2, 3, or 4"s;
 
-        d->logFormat = static_cast<VmafOutputFormat>(logFormat + 1);
+        d->columnarLog = logFormat == 4;
+        d->logFormat = d->columnarLog ? VMAF_OUTPUT_FORMAT_NONE : static_cast<VmafOutputFormat>(logFormat + 1);
 
         VSCoreInfo info;
         vsapi->getCoreInfo(core, &info);
 
+        d->queueDepth = vsapi->mapGetIntSaturated(in, "queue_depth", 0, &err);
+
+        if (d->queueDepth < 0)
+            throw "queue_depth must be greater than or equal to 0"s;
+
+        if (d->queueDepth) {
+            d->queueDepth = std::max(d->queueDepth, info.numThreads);
+            d->queueThreads = info.numThreads;
+            d->queue.resize(d->queueDepth);
+        }
+
+        d->props = !!vsapi->mapGetInt(in, "props", 0, &err);
+
+        if (!!vsapi->mapGetInt(in, "instrument", 0, &err))
+            d->stats = std::make_unique<StageStats>();
+
+        d->streamBatch = vsapi->mapGetIntSaturated(in, "stream", 0, &err);
+
+        if (d->streamBatch < 0)
+            throw "stream must be greater than or equal to 0"s;
+
+        d->streamSync = !!vsapi->mapGetInt(in, "stream_sync", 0, &err);
+
+        d->gateThreshold = vsapi->mapGetFloat(in, "gate", 0, &err);
+        d->gateWindow = err ? 0 : 1;
+
+        if (d->gateWindow) {
+            d->gateWindow = vsapi->mapGetIntSaturated(in, "gate_window", 0, &err);
+            if (err)
+                d->gateWindow = 1;
+
+            if (d->gateWindow < 1)
+                throw "gate_window must be greater than or equal to 1"s;
+
+            d->gateAction = vsapi->mapGetIntSaturated(in, "gate_action", 0, &err);
+
+            if (d->gateAction < 0 || d->gateAction > 1)
+                throw "gate_action must be 0 or 1"s;
+
+            d->gateStop = !!vsapi->mapGetInt(in, "gate_stop", 0, &err);
+            d->gateScores.resize(d->gateWindow);
+        }
+
+        d->lastFrame = d->vi->numFrames - 1;
+
+        d->adaptiveThreshold = vsapi->mapGetFloat(in, "adaptive", 0, &err);
+        d->adaptive = !err;
+
+        if (d->adaptive) {
+            if (d->adaptiveThreshold < 0.0 || d->adaptiveThreshold > 1.0)
+                throw "adaptive must be between 0.0 and 1.0 (inclusive)"s;
+
+            d->adaptiveInterval = vsapi->mapGetIntSaturated(in, "adaptive_interval", 0, &err);
+
+            if (d->adaptiveInterval < 0)
+                throw "adaptive_interval must be greater than or equal to 0"s;
+
+            d->adaptiveSource = -1;
+            d->scoreSource.resize(d->vi->numFrames);
+            for (auto n{ 0 }; n < d->vi->numFrames; n++)
+                d->scoreSource[n] = n;
+        }
+
+        d->inOrder = d->props || d->streamBatch || d->gateWindow || d->adaptive;
+
+        for (auto i{ 0 }; i < vsapi->mapNumElements(in, "percentile"); i++) {
+            d->percentile.emplace_back(vsapi->mapGetFloat(in, "percentile", i, nullptr));
+
+            if (d->percentile[i] < 0.0 || d->percentile[i] > 100.0)
+                throw "percentile must be between 0.0 and 100.0 (inclusive)"s;
+        }
+
+        for (auto i{ 0 }; i < vsapi->mapNumElements(in, "window"); i++) {
+            d->window.emplace_back(vsapi->mapGetIntSaturated(in, "window", i, nullptr));
+
+            if (d->window[i] < 1)
+                throw "window must be greater than or equal to 1"s;
+        }
+
+        if (auto summary{ vsapi->mapGetData(in, "summary", 0, &err) })
+            d->summaryPath = summary;
+
+        auto checkpoint{ vsapi->mapGetData(in, "checkpoint", 0, &err) };
+        auto resumeFrom{ vsapi->mapGetData(in, "resume_from", 0, &err) };
+
+        if ((checkpoint || resumeFrom) && !d->streamBatch)
+            throw "checkpoint and resume_from require stream"s;
+
+        if (d->columnarLog && d->streamBatch)
+            throw "stream doesn't support log_format 4"s;
+
+        // vmaf_write_output only covers the frames libvmaf read, which leaves out the ones adaptive carries forward.
+        if (d->adaptive && !d->streamBatch && !d->columnarLog)
+            throw "adaptive requires stream or log_format 4"s;
+
+        if (d->inOrder && d->queueDepth)
+            throw "props, stream, gate and adaptive can't be used together with queue_depth"s;
+
+        if (!d->ladder.empty() && (d->inOrder || d->queueDepth || !d->percentile.empty() || !d->window.empty() || !d->summaryPath.empty()))
+            throw "queue_depth, props, stream, gate, percentile, window and summary only support a single distorted clip"s;
+
+        d->subsample = vsapi->mapGetIntSaturated(in, "subsample", 0, &err);
+        if (err)
+            d->subsample = 1;
+
+        if (d->subsample < 1)
+            throw "subsample must be greater than or equal to 1"s;
+
+        d->picturePool = !!vsapi->mapGetInt(in, "picture_pool", 0, &err);
+
+#ifndef HAVE_VMAF_PICTURE_POOL
+        if (d->picturePool)
+            throw "picture_pool requires libvmaf 3.0.0 or newer"s;
+#endif
+
+        // Fetching from the pool waits for a free picture, which may be parked in the queue behind the missing frame.
+        if (d->picturePool && d->queueDepth)
+            throw "picture_pool can't be used together with queue_depth"s;
+
+        auto numaNode{ vsapi->mapGetIntSaturated(in, "numa_node", 0, &err) };
+
+        if (!err && (d->numaCpus = numaNodeCpus(numaNode)).empty())
+            throw "numa_node doesn't exist on this system"s;
+
+        auto threads{ vsapi->mapGetIntSaturated(in, "threads", 0, &err) };
+        if (err)
+            threads = d->numaCpus.empty() ? info.numThreads : static_cast<int>(d->numaCpus.size());
+
+        if (threads < 0)
+            throw "threads must be greater than or equal to 0"s;
+
+        // Scores can only be fetched per frame when extraction completes inside vmaf_read_pictures. Otherwise the
+        // worker threads are shared out among the contexts rather than given to each of them.
         VmafConfiguration configuration{};
         configuration.log_level = VMAF_LOG_LEVEL_INFO;
-        configuration.n_threads = info.numThreads;
-        configuration.n_subsample = 1;
+        configuration.n_threads = d->inOrder || !threads ? 0 : std::max(threads / static_cast<int>(d->ladder.size() + 1), 1);
+        configuration.n_subsample = d->subsample;
         configuration.cpumask = 0;
 
-        if (vmaf_init(&d->vmaf, configuration))
-            throw "failed to initialize VMAF context"s;
+        {
+            AffinityScope scope{ d->numaCpus };
+
+            if (vmaf_init(&d->vmaf, configuration))
+                throw "failed to initialize VMAF context"s;
+
+            for (auto&& r : d->ladder)
+                if (vmaf_init(&r.vmaf, configuration))
+                    throw "failed to initialize VMAF context"s;
+        }
+
+        std::vector<VmafContext*> contexts{ d->vmaf };
+        for (auto&& r : d->ladder)
+            contexts.emplace_back(r.vmaf);
 
         if (d->filterName == "VMAF") {
-            if (!vsh::isSameVideoInfo(vsapi->getVideoInfo(d->distorted), d->vi))
-                throw "both clips must have the same format and dimensions"s;
+            auto resizeKernel{ vsapi->mapGetData(in, "resize_kernel", 0, &err) };
+            if (err)
+                resizeKernel = "bicubic";
+
+            if (resizeKernel != "bicubic"s && resizeKernel != "lanczos"s)
+                throw "resize_kernel must be bicubic or lanczos"s;
+
+            for (auto i{ 0 }; i < vsapi->mapNumElements(in, "distorted"); i++) {
+                auto vi{ vsapi->getVideoInfo(i ? d->ladder[i - 1].distorted : d->distorted) };
+
+                if (!vsh::isConstantVideoFormat(vi) ||
+                    vi->format.colorFamily != d->vi->format.colorFamily ||
+                    vi->format.sampleType != d->vi->format.sampleType ||
+                    vi->format.subSamplingW != d->vi->format.subSamplingW ||
+                    vi->format.subSamplingH != d->vi->format.subSamplingH ||
+                    vi->format.bitsPerSample > d->vi->format.bitsPerSample)
+                    throw "distorted clips must have the same format as reference, with a bit depth not higher than it"s;
+
+                if (vi->numFrames != d->vi->numFrames)
+                    throw "both clips' number of frames do not match"s;
 
-            if (vsapi->getVideoInfo(d->distorted)->numFrames != d->vi->numFrames)
-                throw "both clips' number of frames do not match"s;
+                // A clip that only differs in bit depth is converted by the plane copy itself.
+                if (vi->width == d->vi->width && vi->height == d->vi->height)
+                    continue;
+
+                auto rescaler{ std::make_unique<Rescaler>() };
+                rescaler->scale = std::ldexp(1.0f, d->bitDepth - vi->format.bitsPerSample);
+
+                for (auto plane{ 0 }; plane < d->vi->format.numPlanes; plane++) {
+                    auto ssw{ plane ? d->vi->format.subSamplingW : 0 };
+                    auto ssh{ plane ? d->vi->format.subSamplingH : 0 };
+                    rescaler->horizontal[plane] = makeResampleAxis(vi->width >> ssw, d->vi->width >> ssw, resizeKernel == "lanczos"s);
+                    rescaler->vertical[plane] = makeResampleAxis(vi->height >> ssh, d->vi->height >> ssh, resizeKernel == "lanczos"s);
+                }
+
+                if (d->region.width != d->vi->width || d->region.height != d->vi->height)
+                    throw "crop and autocrop can't be used with distorted clips of different dimensions"s;
+
+                (i ? d->ladder[i - 1].rescaler : d->rescaler) = std::move(rescaler);
+            }
 
             auto model{ vsapi->mapGetIntArray(in, "model", &err) };
             auto numModels{ vsapi->mapNumElements(in, "model") };
@@ -228,6 +1888,8 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
                 if (std::count(model, model + numModels, model[i]) > 1)
                     throw "duplicate model specified"s;
 
+                d->modelScoreName.emplace_back(modelName[model[i]]);
+
                 VmafModelConfig modelConfig{};
                 modelConfig.name = modelName[model[i]];
                 modelConfig.flags = VMAF_MODEL_FLAGS_DEFAULT;
@@ -238,14 +1900,16 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
                     if (vmaf_model_collection_load(&d->model[i], &d->modelCollection[d->modelCollection.size() - 1], &modelConfig, modelVersion[model[i]]))
                         throw "failed to load model: "s + modelVersion[model[i]];
 
-                    if (vmaf_use_features_from_model_collection(d->vmaf, d->modelCollection[d->modelCollection.size() - 1]))
-                        throw "failed to load feature extractors from model collection: "s + modelVersion[model[i]];
+                    for (auto&& c : contexts)
+                        if (vmaf_use_features_from_model_collection(c, d->modelCollection[d->modelCollection.size() - 1]))
+                            throw "failed to load feature extractors from model collection: "s + modelVersion[model[i]];
 
                     continue;
                 }
 
-                if (vmaf_use_features_from_model(d->vmaf, d->model[i]))
-                    throw "failed to load feature extractors from model: "s + modelVersion[model[i]];
+                for (auto&& c : contexts)
+                    if (vmaf_use_features_from_model(c, d->model[i]))
+                        throw "failed to load feature extractors from model: "s + modelVersion[model[i]];
             }
 
             for (auto i{ 0 }; i < numFeatures; i++) {
@@ -255,8 +1919,11 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
                 if (std::count(feature, feature + numFeatures, feature[i]) > 1)
                     throw "duplicate feature specified"s;
 
-                if (vmaf_use_feature(d->vmaf, featureName[feature[i]], nullptr))
-                    throw "failed to load feature extractor: "s + featureName[feature[i]];
+                for (auto&& c : contexts)
+                    if (vmaf_use_feature(c, featureName[feature[i]], nullptr))
+                        throw "failed to load feature extractor: "s + featureName[feature[i]];
+
+                d->featureScoreName.insert(d->featureScoreName.cend(), featureScoreNames[feature[i]].cbegin(), featureScoreNames[feature[i]].cend());
 
                 switch (feature[i]) {
                 case 0:
@@ -265,11 +1932,14 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
                     d->chroma = true;
                 }
             }
+
+            if (d->gateWindow && d->modelScoreName.empty() && d->featureScoreName.empty())
+                throw "gate requires a model or feature"s;
         } else {
             std::array<char, 32> str{};
             VmafFeatureDictionary* featureDictionary{};
 
-            static auto setFeatureDictionary = [&](auto val, const char* key) {
+            auto setFeatureDictionary = [&](auto val, const char* key) {
                 if (auto [ptr, ec] = std::to_chars(str.data(), str.data() + str.size(), val); ec == std::errc())
                     if (vmaf_feature_dictionary_set(&featureDictionary, key, std::string(str.data(), ptr).c_str()))
                         throw "failed to set feature option: "s + key;
@@ -319,25 +1989,98 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
                 vmaf_feature_dictionary_free(&featureDictionary);
                 throw "failed to load feature extractor: cambi"s;
             }
+
+            d->featureScoreName.emplace_back("cambi");
+            if (d->adaptive)
+                d->featureScoreName.emplace_back("cambi_interpolated");
         }
 
-        if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 1)
+        // Without a chroma-aware feature only the luma plane is allocated and carried through libvmaf.
+        if (!d->chroma)
+            d->pixelFormat = VMAF_PIX_FMT_YUV400P;
+        else if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 1)
             d->pixelFormat = VMAF_PIX_FMT_YUV420P;
         else if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 0)
             d->pixelFormat = VMAF_PIX_FMT_YUV422P;
         else
             d->pixelFormat = VMAF_PIX_FMT_YUV444P;
+
+#ifdef HAVE_VMAF_PICTURE_POOL
+        if (d->picturePool) {
+            VmafPictureConfiguration pictureConfiguration{};
+            pictureConfiguration.pic_params.w = d->region.width;
+            pictureConfiguration.pic_params.h = d->region.height;
+            pictureConfiguration.pic_params.bpc = d->bitDepth;
+            pictureConfiguration.pic_params.pix_fmt = d->pixelFormat;
+            pictureConfiguration.pic_prealloc_method = VMAF_PICTURE_PREALLOCATION_METHOD_HOST;
+
+            if (vmaf_preallocate_pictures(d->vmaf, pictureConfiguration))
+                throw "failed to preallocate pictures"s;
+        }
+#endif
+
+        std::vector<std::pair<int, std::vector<double>>> records;
+
+        // Resuming starts by reading the last checkpointed frame again, which primes the temporal features of the
+        // next one. Its feature scores are recomputed by that read, while all other scores are imported as they were.
+        if (resumeFrom) {
+            records = readCheckpoint(d.get(), resumeFrom);
+
+            for (auto&& [n, scores] : records) {
+                for (size_t i{}; i < scores.size(); i++) {
+                    if (i >= d->modelScoreName.size() && n == records.back().first)
+                        break;
+
+                    if (vmaf_import_feature_score(d->vmaf, scoreName(d.get(), i), scores[i], n))
+                        throw "failed to import score from checkpoint: "s + scoreName(d.get(), i);
+                }
+            }
+
+            if (!records.empty())
+                d->resumeFrame = d->readNext = records.back().first;
+        }
+
+        if (d->streamBatch) {
+            if (!(d->logFile = std::fopen(d->logPath.c_str(), "w")))
+                throw "failed to open log file: "s + d->logPath;
+
+            std::setvbuf(d->logFile, nullptr, _IOFBF, 1 << 20);
+
+            if (checkpoint) {
+                if (!(d->checkpointFile = std::fopen(checkpoint, "wb")))
+                    throw "failed to open checkpoint: "s + checkpoint;
+
+                if (!writeCheckpointHeader(d.get()))
+                    throw "failed to write checkpoint"s;
+            }
+
+            if (!writeLogHeader(d.get()))
+                throw "failed to write VMAF stats"s;
+
+            for (auto&& [n, scores] : records)
+                if (!writeLogFrame(d.get(), n, scores))
+                    throw "failed to write VMAF stats"s;
+        }
     } catch (const std::string& error) {
         vsapi->mapSetError(out, (d->filterName + ": " + error).c_str());
 
+        if (d->logFile)
+            std::fclose(d->logFile);
+        if (d->checkpointFile)
+            std::fclose(d->checkpointFile);
+
         vsapi->freeNode(d->reference);
         vsapi->freeNode(d->distorted);
+        for (auto&& r : d->ladder)
+            vsapi->freeNode(r.distorted);
 
         for (auto&& m : d->model)
             vmaf_model_destroy(m);
         for (auto&& m : d->modelCollection)
             vmaf_model_collection_destroy(m);
         vmaf_close(d->vmaf);
+        for (auto&& r : d->ladder)
+            vmaf_close(r.vmaf);
 
         return;
     }
@@ -346,14 +2089,77 @@ static void VS_CC vmafCreate(const VSMap* in, VSMap* out, void* userData, VSCore
     deps.push_back({ d->reference, rpStrictSpatial });
     if (d->filterName == "VMAF")
         deps.push_back({ d->distorted, rpStrictSpatial });
+    for (auto&& r : d->ladder)
+        deps.push_back({ r.distorted, rpStrictSpatial });
+
+    if (d->queueDepth) {
+        AffinityScope scope{ d->numaCpus };
+        d->feeder = std::thread{ vmafFeed, d.get() };
+    }
 
-    vsapi->createVideoFilter(out, d->filterName.c_str(), d->vi, vmafGetFrame, vmafFree, fmFrameState, deps.data(), deps.size(), d.get(), core);
+    vsapi->createVideoFilter(out, d->filterName.c_str(), d->vi, vmafGetFrame, vmafFree, d->queueDepth ? fmParallel : fmFrameState, deps.data(), deps.size(), d.get(), core);
     d.release();
 }
 
 //////////////////////////////////////////
 // Metric
 
+// Contexts are created once and leased to whichever thread processes a frame. Each one runs libvmaf without
+// its own thread pool, so scores are ready right after vmaf_read_pictures and no flush is ever needed. The
+// index only counts the pictures a context has read, since the actual frame number may be read more than once.
+struct MetricContext final {
+    VmafContext* vmaf;
+    unsigned index;
+};
+
+// Recently computed scores keyed by the (reference, distorted) picture hashes. The list is kept in least recently used
+// order with the newest entry at the front, and the map points into it.
+struct ScoreCache final {
+    using Key = std::pair<uint64_t, uint64_t>;
+
+    struct KeyHash final {
+        size_t operator()(const Key& key) const noexcept {
+            return static_cast<size_t>(key.first ^ (key.second * 0x9E3779B97F4A7C15));
+        }
+    };
+
+    using Entry = std::pair<Key, std::vector<double>>;
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    std::mutex mutex;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    bool find(const Key& key, std::vector<double>& scores) {
+        std::lock_guard lock{ mutex };
+
+        auto it{ index.find(key) };
+        if (it == index.end())
+            return false;
+
+        entries.splice(entries.begin(), entries, it->second);
+        scores = it->second->second;
+        return true;
+    }
+
+    void insert(const Key& key, const std::vector<double>& scores) {
+        std::lock_guard lock{ mutex };
+
+        if (index.count(key))
+            return;
+
+        entries.emplace_front(key, scores);
+        index.emplace(key, entries.begin());
+
+        if (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+};
+
 struct MetricData final {
     VSNode* reference;
     VSNode* distorted;
@@ -363,11 +2169,17 @@ struct MetricData final {
     VmafConfiguration configuration;
     VmafPixelFormat pixelFormat;
     bool chroma;
+    Region region;
+    std::unique_ptr<StageStats> stats;
+    std::vector<MetricContext> contextPool;
+    std::mutex contextMutex;
+    std::unique_ptr<ScoreCache> cache;
 };
 
-static const VSFrame* VS_CC metricGetFrame(int n, int activationReason, void* instanceData, [[maybe_unused]] void** frameData,
+static const VSFrame* VS_CC metricGetFrame(int n, int activationReason, void* instanceData, void** frameData,
                                            VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi) {
-    auto d{ static_cast<const MetricData*>(instanceData) };
+    auto d{ static_cast<MetricData*>(instanceData) };
+    trackUpstream(d->stats.get(), activationReason, frameData);
 
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->reference, frameCtx);
@@ -378,57 +2190,90 @@ static const VSFrame* VS_CC metricGetFrame(int n, int activationReason, void* in
         auto dst{ vsapi->copyFrame(distorted, core) };
         auto props{ vsapi->getFramePropertiesRW(dst) };
 
-        VmafContext* vmaf{};
+        auto numPlanes{ d->chroma ? d->vi->format.numPlanes : 1 };
+        ScoreCache::Key key{};
+        std::vector<double> scores;
+
+        if (d->cache) {
+            {
+                StageTimer timer{ d->stats.get(), stageCopy };
+                key = { hashPicture(reference, numPlanes, d->region, vsapi), hashPicture(distorted, numPlanes, d->region, vsapi) };
+            }
+
+            if (d->cache->find(key, scores)) {
+                d->cache->hits++;
+
+                for (size_t i{}; i < d->featureScoreName.size(); i++)
+                    vsapi->mapSetFloat(props, d->featureScoreName[i], scores[i], maReplace);
+
+                if (d->stats)
+                    setStageProps(props, vsapi);
+
+                vsapi->freeFrame(reference);
+                vsapi->freeFrame(distorted);
+                return dst;
+            }
+
+            d->cache->misses++;
+        }
+
+        MetricContext context{};
         VmafPicture ref{};
         VmafPicture dist{};
 
+        {
+            std::lock_guard lock{ d->contextMutex };
+
+            if (!d->contextPool.empty()) {
+                context = d->contextPool.back();
+                d->contextPool.pop_back();
+            }
+        }
+
         try {
-            if (vmaf_init(&vmaf, d->configuration))
-                throw "failed to initialize VMAF context";
-
-            for (auto&& f : d->feature)
-                if (vmaf_use_feature(vmaf, featureName[f], nullptr))
-                    throw ("failed to load feature extractor: "s + featureName[f]).c_str();
-
-            if (vmaf_picture_alloc(&ref, d->pixelFormat, d->vi->format.bitsPerSample, d->vi->width, d->vi->height) ||
-                vmaf_picture_alloc(&dist, d->pixelFormat, d->vi->format.bitsPerSample, d->vi->width, d->vi->height))
-                throw "failed to allocate picture";
-
-            for (auto plane{ 0 }; plane < d->vi->format.numPlanes; plane++) {
-                if (plane && !d->chroma)
-                    break;
-
-                vsh::bitblt(ref.data[plane],
-                            ref.stride[plane],
-                            vsapi->getReadPtr(reference, plane),
-                            vsapi->getStride(reference, plane),
-                            vsapi->getFrameWidth(reference, plane) * d->vi->format.bytesPerSample,
-                            vsapi->getFrameHeight(reference, plane));
-
-                vsh::bitblt(dist.data[plane],
-                            dist.stride[plane],
-                            vsapi->getReadPtr(distorted, plane),
-                            vsapi->getStride(distorted, plane),
-                            vsapi->getFrameWidth(distorted, plane) * d->vi->format.bytesPerSample,
-                            vsapi->getFrameHeight(distorted, plane));
+            if (!context.vmaf) {
+                if (vmaf_init(&context.vmaf, d->configuration))
+                    throw "failed to initialize VMAF context";
+
+                for (auto&& f : d->feature)
+                    if (vmaf_use_feature(context.vmaf, featureName[f], nullptr))
+                        throw ("failed to load feature extractor: "s + featureName[f]).c_str();
             }
 
-            if (vmaf_read_pictures(vmaf, &ref, &dist, n))
-                throw "failed to read pictures";
+            {
+                StageTimer timer{ d->stats.get(), stageAlloc };
+
+                if (vmaf_picture_alloc(&ref, d->pixelFormat, d->vi->format.bitsPerSample, d->region.width, d->region.height) ||
+                    vmaf_picture_alloc(&dist, d->pixelFormat, d->vi->format.bitsPerSample, d->region.width, d->region.height))
+                    throw "failed to allocate picture";
+            }
+
+            {
+                StageTimer timer{ d->stats.get(), stageCopy };
+                copyPicture(ref, reference, numPlanes, d->region, vsapi);
+                copyPicture(dist, distorted, numPlanes, d->region, vsapi);
+            }
 
-            if (vmaf_read_pictures(vmaf, nullptr, nullptr, 0))
-                throw "failed to flush context";
+            if (readPictures(context.vmaf, &ref, &dist, context.index, d->stats.get()))
+                throw "failed to read pictures";
 
             for (auto&& f : d->featureScoreName) {
                 double score;
 
-                if (vmaf_feature_score_at_index(vmaf, f, &score, n))
+                if (vmaf_feature_score_at_index(context.vmaf, f, &score, context.index))
                     throw ("failed to fetch feature score: "s + f).c_str();
 
                 vsapi->mapSetFloat(props, f, score, maReplace);
+                scores.push_back(score);
             }
 
-            vmaf_close(vmaf);
+            if (d->stats)
+                setStageProps(props, vsapi);
+
+            if (d->cache)
+                d->cache->insert(key, scores);
+
+            context.index++;
         } catch (const char* error) {
             vsapi->setFilterError(("Metric: "s + error).c_str(), frameCtx);
 
@@ -436,13 +2281,18 @@ static const VSFrame* VS_CC metricGetFrame(int n, int activationReason, void* in
             vsapi->freeFrame(distorted);
             vsapi->freeFrame(dst);
 
-            vmaf_close(vmaf);
+            vmaf_close(context.vmaf);
             vmaf_picture_unref(&ref);
             vmaf_picture_unref(&dist);
 
             return nullptr;
         }
 
+        {
+            std::lock_guard lock{ d->contextMutex };
+            d->contextPool.push_back(context);
+        }
+
         vsapi->freeFrame(reference);
         vsapi->freeFrame(distorted);
         return dst;
@@ -451,10 +2301,22 @@ static const VSFrame* VS_CC metricGetFrame(int n, int activationReason, void* in
     return nullptr;
 }
 
-static void VS_CC metricFree(void* instanceData, [[maybe_unused]] VSCore* core, const VSAPI* vsapi) {
+static void VS_CC metricFree(void* instanceData, VSCore* core, const VSAPI* vsapi) {
     auto d{ static_cast<MetricData*>(instanceData) };
     vsapi->freeNode(d->reference);
     vsapi->freeNode(d->distorted);
+
+    for (auto&& c : d->contextPool)
+        vmaf_close(c.vmaf);
+
+    if (d->cache)
+        vsapi->logMessage(mtInformation,
+                          ("Metric: cache: " + std::to_string(d->cache->hits) + " hits, " + std::to_string(d->cache->misses) + " misses").c_str(),
+                          core);
+
+    if (d->stats)
+        logStageStats(*d->stats, "Metric", core, vsapi);
+
     delete d;
 }
 
@@ -492,11 +2354,8 @@ static void VS_CC metricCreate(const VSMap* in, VSMap* out, [[maybe_unused]] voi
         if (vsapi->getVideoInfo(d->distorted)->numFrames != d->vi->numFrames)
             throw "both clips' number of frames do not match";
 
-        VSCoreInfo info;
-        vsapi->getCoreInfo(core, &info);
-
         d->configuration.log_level = VMAF_LOG_LEVEL_INFO;
-        d->configuration.n_threads = info.numThreads;
+        d->configuration.n_threads = 0;
         d->configuration.n_subsample = 1;
         d->configuration.cpumask = 0;
 
@@ -509,34 +2368,36 @@ static void VS_CC metricCreate(const VSMap* in, VSMap* out, [[maybe_unused]] voi
             if (std::count(d->feature.cbegin(), d->feature.cend(), d->feature[i]) > 1)
                 throw "duplicate feature specified";
 
+            d->featureScoreName.insert(d->featureScoreName.cend(), featureScoreNames[d->feature[i]].cbegin(), featureScoreNames[d->feature[i]].cend());
+
             switch (d->feature[i]) {
             case 0:
-                d->featureScoreName.emplace_back("psnr_y");
-                d->featureScoreName.emplace_back("psnr_cb");
-                d->featureScoreName.emplace_back("psnr_cr");
-                d->chroma = true;
-                break;
             case 1:
-                d->featureScoreName.emplace_back("psnr_hvs_y");
-                d->featureScoreName.emplace_back("psnr_hvs_cb");
-                d->featureScoreName.emplace_back("psnr_hvs_cr");
-                d->featureScoreName.emplace_back("psnr_hvs");
-                d->chroma = true;
-                break;
-            case 2:
-                d->featureScoreName.emplace_back("float_ssim");
-                break;
-            case 3:
-                d->featureScoreName.emplace_back("float_ms_ssim");
-                break;
             case 4:
-                d->featureScoreName.emplace_back("ciede2000");
                 d->chroma = true;
-                break;
             }
         }
 
-        if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 1)
+        int err;
+        if (!!vsapi->mapGetInt(in, "instrument", 0, &err))
+            d->stats = std::make_unique<StageStats>();
+
+        if (auto error{ parseRegion(d->region, in, d->reference, "Metric", core, vsapi) })
+            throw error;
+
+        auto cache{ vsapi->mapGetIntSaturated(in, "cache", 0, &err) };
+        if (cache < 0)
+            throw "cache must be greater than or equal to 0";
+
+        if (cache) {
+            d->cache = std::make_unique<ScoreCache>();
+            d->cache->capacity = cache;
+        }
+
+        // Without a chroma-aware feature only the luma plane is allocated and carried through libvmaf.
+        if (!d->chroma)
+            d->pixelFormat = VMAF_PIX_FMT_YUV400P;
+        else if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 1)
             d->pixelFormat = VMAF_PIX_FMT_YUV420P;
         else if (d->vi->format.subSamplingW == 1 && d->vi->format.subSamplingH == 0)
             d->pixelFormat = VMAF_PIX_FMT_YUV422P;
@@ -554,6 +2415,169 @@ static void VS_CC metricCreate(const VSMap* in, VSMap* out, [[maybe_unused]] voi
     d.release();
 }
 
+//////////////////////////////////////////
+// LoadScores
+
+// Read-only mapping of a whole file, released on destruction.
+class MappedFile final {
+public:
+    MappedFile() noexcept = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (!view)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+#else
+        munmap(view, length);
+#endif
+    }
+
+    bool open(const char* path) noexcept {
+#ifdef _WIN32
+        auto file{ CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        auto mapping{ GetFileSizeEx(file, &size) && size.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr };
+        if (mapping) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            length = static_cast<size_t>(size.QuadPart);
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        auto fd{ ::open(path, O_RDONLY) };
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0) {
+            auto p{ mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0) };
+            if (p != MAP_FAILED) {
+                view = p;
+                length = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+#endif
+        return view;
+    }
+
+    const uint8_t* data() const noexcept {
+        return static_cast<const uint8_t*>(view);
+    }
+
+    size_t size() const noexcept {
+        return length;
+    }
+
+private:
+    void* view{};
+    size_t length{};
+};
+
+// Scores stay in the mapping, so a frame only costs one lookup per score no matter where in the file it is.
+struct LoadScoresData final {
+    VSNode* node;
+    MappedFile file;
+    std::vector<std::string> scoreName;
+    const double* scores;
+    int numFrames;
+};
+
+static const VSFrame* VS_CC loadScoresGetFrame(int n, int activationReason, void* instanceData, [[maybe_unused]] void** frameData,
+                                               VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi) {
+    auto d{ static_cast<LoadScoresData*>(instanceData) };
+
+    if (activationReason == arInitial) {
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        auto src{ vsapi->getFrameFilter(n, d->node, frameCtx) };
+        auto dst{ vsapi->copyFrame(src, core) };
+        auto props{ vsapi->getFramePropertiesRW(dst) };
+
+        for (size_t i{}; i < d->scoreName.size(); i++) {
+            auto score{ d->scores[i * d->numFrames + n] };
+
+            if (!std::isnan(score))
+                vsapi->mapSetFloat(props, d->scoreName[i].c_str(), score, maReplace);
+        }
+
+        vsapi->freeFrame(src);
+        return dst;
+    }
+
+    return nullptr;
+}
+
+static void VS_CC loadScoresFree(void* instanceData, [[maybe_unused]] VSCore* core, const VSAPI* vsapi) {
+    auto d{ static_cast<LoadScoresData*>(instanceData) };
+    vsapi->freeNode(d->node);
+    delete d;
+}
+
+static void VS_CC loadScoresCreate(const VSMap* in, VSMap* out, [[maybe_unused]] void* userData, VSCore* core, const VSAPI* vsapi) {
+    auto d{ std::make_unique<LoadScoresData>() };
+
+    try {
+        d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+        auto vi{ vsapi->getVideoInfo(d->node) };
+        auto path{ vsapi->mapGetData(in, "path", 0, nullptr) };
+
+        if (!d->file.open(path))
+            throw "failed to open score file: "s + path;
+
+        auto data{ d->file.data() };
+        auto size{ d->file.size() };
+        uint32_t header[2];
+
+        if (size < sizeof(columnarMagic) + sizeof(header) || std::memcmp(data, columnarMagic, sizeof(columnarMagic)))
+            throw "not a columnar score file: "s + path;
+
+        std::memcpy(header, data + sizeof(columnarMagic), sizeof(header));
+        auto offset{ sizeof(columnarMagic) + sizeof(header) };
+
+        for (uint32_t i{}; i < header[1]; i++) {
+            uint32_t length;
+
+            if (size - offset < sizeof(length))
+                throw "truncated score file: "s + path;
+
+            std::memcpy(&length, data + offset, sizeof(length));
+            offset += sizeof(length);
+
+            if (size - offset < length)
+                throw "truncated score file: "s + path;
+
+            d->scoreName.emplace_back(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+        }
+
+        offset = (offset + 7) & ~size_t{ 7 };
+
+        if (offset > size || (size - offset) / sizeof(double) / std::max(header[1], 1u) < header[0])
+            throw "truncated score file: "s + path;
+
+        if (vi->numFrames > static_cast<int>(header[0]))
+            throw "clip has more frames than the score file: "s + path;
+
+        d->scores = reinterpret_cast<const double*>(data + offset);
+        d->numFrames = header[0];
+    } catch (const std::string& error) {
+        vsapi->mapSetError(out, ("LoadScores: " + error).c_str());
+        vsapi->freeNode(d->node);
+        return;
+    }
+
+    VSFilterDependency deps[]{ {d->node, rpStrictSpatial} };
+    vsapi->createVideoFilter(out, "LoadScores", vsapi->getVideoInfo(d->node), loadScoresGetFrame, loadScoresFree, fmParallel, deps, 1, d.get(), core);
+    d.release();
+}
+
 //////////////////////////////////////////
 // Init
 
@@ -562,11 +2586,33 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
 
     vspapi->registerFunction("VMAF",
                              "reference:vnode;"
-                             "distorted:vnode;"
-                             "log_path:data;"
+                             "distorted:vnode[];"
+                             "log_path:data[];"
                              "log_format:int:opt;"
                              "model:int[]:opt;"
-                             "feature:int[]:opt;",
+                             "feature:int[]:opt;"
+                             "queue_depth:int:opt;"
+                             "props:int:opt;"
+                             "subsample:int:opt;"
+                             "stream:int:opt;"
+                             "stream_sync:int:opt;"
+                             "checkpoint:data:opt;"
+                             "resume_from:data:opt;"
+                             "percentile:float[]:opt;"
+                             "window:int[]:opt;"
+                             "resize_kernel:data:opt;"
+                             "bit_depth:int:opt;"
+                             "instrument:int:opt;"
+                             "crop:int[]:opt;"
+                             "autocrop:int:opt;"
+                             "gate:float:opt;"
+                             "gate_window:int:opt;"
+                             "gate_action:int:opt;"
+                             "gate_stop:int:opt;"
+                             "threads:int:opt;"
+                             "numa_node:int:opt;"
+                             "picture_pool:int:opt;"
+                             "summary:data:opt;",
                              "clip:vnode;",
                              vmafCreate, const_cast<char*>("VMAF"), plugin);
 
@@ -579,14 +2625,43 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
                              "tvi_threshold:float:opt;"
                              "max_log_contrast:int:opt;"
                              "enc_width:int:opt;"
-                             "enc_height:int:opt;",
+                             "enc_height:int:opt;"
+                             "queue_depth:int:opt;"
+                             "props:int:opt;"
+                             "subsample:int:opt;"
+                             "stream:int:opt;"
+                             "stream_sync:int:opt;"
+                             "checkpoint:data:opt;"
+                             "resume_from:data:opt;"
+                             "percentile:float[]:opt;"
+                             "window:int[]:opt;"
+                             "bit_depth:int:opt;"
+                             "instrument:int:opt;"
+                             "crop:int[]:opt;"
+                             "autocrop:int:opt;"
+                             "adaptive:float:opt;"
+                             "adaptive_interval:int:opt;"
+                             "threads:int:opt;"
+                             "numa_node:int:opt;"
+                             "picture_pool:int:opt;"
+                             "summary:data:opt;",
                              "clip:vnode;",
                              vmafCreate, const_cast<char*>("CAMBI"), plugin);
 
     vspapi->registerFunction("Metric",
                              "reference:vnode;"
                              "distorted:vnode;"
-                             "feature:int[];",
+                             "feature:int[];"
+                             "instrument:int:opt;"
+                             "crop:int[]:opt;"
+                             "autocrop:int:opt;"
+                             "cache:int:opt;",
                              "clip:vnode;",
                              metricCreate, nullptr, plugin);
+
+    vspapi->registerFunction("LoadScores",
+                             "clip:vnode;"
+                             "path:data;",
+                             "clip:vnode;",
+                             loadScoresCreate, nullptr, plugin);
 }
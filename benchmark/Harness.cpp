@@ -0,0 +1,648 @@
+/*
+    MIT License
+
+    Copyright (c) 2018-2022 HolyWu
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Measures the overhead of the plugin itself, without the VapourSynth core.
+//
+// The filters are created and driven through a minimal stand-in for VSAPI that serves synthetic frames, so the
+// numbers only contain the work done by VMAF.cpp and libvmaf. Every case is run twice:
+//   - pipeline: vmafCreate/metricCreate, getFrame for every frame and the free function, as VapourSynth would.
+//   - stages: the steps of getFrame timed one by one (alloc, copy, read_pictures), then flush and write_output.
+// With more than one hardware thread, the VMAF pipeline is also run with smaller libvmaf thread budgets (the threads
+// argument) to compare them against the default of one libvmaf thread per VapourSynth thread, and with queue_depth,
+// where getFrame is called from as many threads as VapourSynth would use to compare against the serialized mode.
+// Metric is also run at 1080p and 2160p with its context pool and with a fresh context for every frame, the way it
+// scored frames before the pool.
+//
+// Usage: vmaf_bench [frames=60] [width=1920] [height=1080]
+// Prints one JSON object per line and case to stdout. peak_rss_kib is the peak of the whole process so far.
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../VMAF/VMAF.cpp"
+
+struct VSMap {
+    std::map<std::string, std::vector<int64_t>> ints;
+    std::map<std::string, std::vector<double>> floats;
+    std::map<std::string, std::vector<std::string>> data;
+    std::map<std::string, std::vector<VSNode*>> nodes;
+    std::string error;
+
+    VSFilterGetFrame getFrame;
+    VSFilterFree free;
+    void* instanceData;
+};
+
+struct VSFrame {
+    VSVideoFormat format;
+    std::array<int, 3> width;
+    std::array<int, 3> height;
+    std::array<ptrdiff_t, 3> stride;
+    std::array<uint8_t*, 3> data;
+    std::vector<uint8_t> storage;
+    VSMap props;
+    bool owned;
+    int refs;
+};
+
+struct VSNode {
+    VSVideoInfo vi;
+    std::vector<std::unique_ptr<VSFrame>> frames;
+};
+
+struct VSCore {
+    int numThreads;
+};
+
+struct VSFrameContext {
+    std::string error;
+};
+
+namespace standin {
+    template<typename T>
+    static const T* find(const std::map<std::string, std::vector<T>>& values, const char* key, int index, int* error) noexcept {
+        auto it{ values.find(key) };
+
+        if (it == values.end() || index < 0 || index >= static_cast<int>(it->second.size())) {
+            if (error)
+                *error = it == values.end() ? peUnset : peIndex;
+            return nullptr;
+        }
+
+        if (error)
+            *error = 0;
+        return &it->second[index];
+    }
+
+    static void VS_CC createVideoFilter(VSMap* out, [[maybe_unused]] const char* name, [[maybe_unused]] const VSVideoInfo* vi, VSFilterGetFrame getFrame,
+                                        VSFilterFree free, [[maybe_unused]] int filterMode, [[maybe_unused]] const VSFilterDependency* dependencies,
+                                        [[maybe_unused]] int numDeps, void* instanceData, [[maybe_unused]] VSCore* core) noexcept {
+        out->getFrame = getFrame;
+        out->free = free;
+        out->instanceData = instanceData;
+    }
+
+    // Source frames are shared by every thread calling getFrame, and only copies are reference counted.
+    static const VSFrame* VS_CC addFrameRef(const VSFrame* f) noexcept {
+        if (f->owned)
+            const_cast<VSFrame*>(f)->refs++;
+        return f;
+    }
+
+    static void VS_CC freeFrame(const VSFrame* f) noexcept {
+        if (f && f->owned && !--const_cast<VSFrame*>(f)->refs)
+            delete f;
+    }
+
+    static VSFrame* VS_CC copyFrame(const VSFrame* f, [[maybe_unused]] VSCore* core) noexcept {
+        auto frame{ new VSFrame{ *f } };
+
+        for (auto plane{ 0 }; plane < f->format.numPlanes; plane++)
+            frame->data[plane] = frame->storage.data() + (f->data[plane] - f->storage.data());
+
+        frame->owned = true;
+        frame->refs = 1;
+        return frame;
+    }
+
+    static VSMap* VS_CC getFramePropertiesRW(VSFrame* f) noexcept { return &f->props; }
+    static ptrdiff_t VS_CC getStride(const VSFrame* f, int plane) noexcept { return f->stride[plane]; }
+    static const uint8_t* VS_CC getReadPtr(const VSFrame* f, int plane) noexcept { return f->data[plane]; }
+    static const VSVideoFormat* VS_CC getVideoFrameFormat(const VSFrame* f) noexcept { return &f->format; }
+    static int VS_CC getFrameWidth(const VSFrame* f, int plane) noexcept { return f->width[plane]; }
+    static int VS_CC getFrameHeight(const VSFrame* f, int plane) noexcept { return f->height[plane]; }
+
+    // Nodes are owned by the harness and outlive every filter.
+    static void VS_CC freeNode([[maybe_unused]] VSNode* node) noexcept {}
+    static const VSVideoInfo* VS_CC getVideoInfo(VSNode* node) noexcept { return &node->vi; }
+
+    static void VS_CC requestFrameFilter([[maybe_unused]] int n, [[maybe_unused]] VSNode* node, [[maybe_unused]] VSFrameContext* frameCtx) noexcept {}
+
+    static const VSFrame* VS_CC getFrameFilter(int n, VSNode* node, [[maybe_unused]] VSFrameContext* frameCtx) noexcept {
+        return node->frames[n % node->frames.size()].get();
+    }
+
+    static void VS_CC setFilterError(const char* errorMessage, VSFrameContext* frameCtx) noexcept { frameCtx->error = errorMessage; }
+    static void VS_CC mapSetError(VSMap* map, const char* errorMessage) noexcept { map->error = errorMessage; }
+
+    static int VS_CC mapNumElements(const VSMap* map, const char* key) noexcept {
+        if (auto it{ map->ints.find(key) }; it != map->ints.end())
+            return static_cast<int>(it->second.size());
+        if (auto it{ map->floats.find(key) }; it != map->floats.end())
+            return static_cast<int>(it->second.size());
+        if (auto it{ map->data.find(key) }; it != map->data.end())
+            return static_cast<int>(it->second.size());
+        if (auto it{ map->nodes.find(key) }; it != map->nodes.end())
+            return static_cast<int>(it->second.size());
+        return -1;
+    }
+
+    static int64_t VS_CC mapGetInt(const VSMap* map, const char* key, int index, int* error) noexcept {
+        auto value{ find(map->ints, key, index, error) };
+        return value ? *value : 0;
+    }
+
+    static int VS_CC mapGetIntSaturated(const VSMap* map, const char* key, int index, int* error) noexcept {
+        return static_cast<int>(std::clamp<int64_t>(mapGetInt(map, key, index, error), INT_MIN, INT_MAX));
+    }
+
+    static const int64_t* VS_CC mapGetIntArray(const VSMap* map, const char* key, int* error) noexcept {
+        auto value{ find(map->ints, key, 0, error) };
+        return value;
+    }
+
+    static double VS_CC mapGetFloat(const VSMap* map, const char* key, int index, int* error) noexcept {
+        auto value{ find(map->floats, key, index, error) };
+        return value ? *value : 0.0;
+    }
+
+    static int VS_CC mapSetInt(VSMap* map, const char* key, int64_t i, int append) noexcept {
+        auto& values{ map->ints[key] };
+        if (append == maReplace)
+            values.clear();
+        values.push_back(i);
+        return 0;
+    }
+
+    static int VS_CC mapSetFloat(VSMap* map, const char* key, double d, int append) noexcept {
+        auto& values{ map->floats[key] };
+        if (append == maReplace)
+            values.clear();
+        values.push_back(d);
+        return 0;
+    }
+
+    static const char* VS_CC mapGetData(const VSMap* map, const char* key, int index, int* error) noexcept {
+        auto value{ find(map->data, key, index, error) };
+        return value ? value->c_str() : nullptr;
+    }
+
+    static VSNode* VS_CC mapGetNode(const VSMap* map, const char* key, int index, int* error) noexcept {
+        auto value{ find(map->nodes, key, index, error) };
+        return value ? *value : nullptr;
+    }
+
+    static void VS_CC getCoreInfo(VSCore* core, VSCoreInfo* info) noexcept {
+        *info = {};
+        info->numThreads = core->numThreads;
+    }
+
+    static void VS_CC logMessage(int msgType, const char* msg, [[maybe_unused]] VSCore* core) noexcept {
+        if (msgType >= mtWarning)
+            std::fprintf(stderr, "%s\n", msg);
+    }
+
+    static VSAPI makeAPI() noexcept {
+        VSAPI api{};
+        api.createVideoFilter = createVideoFilter;
+        api.addFrameRef = addFrameRef;
+        api.freeFrame = freeFrame;
+        api.copyFrame = copyFrame;
+        api.getFramePropertiesRW = getFramePropertiesRW;
+        api.getStride = getStride;
+        api.getReadPtr = getReadPtr;
+        api.getVideoFrameFormat = getVideoFrameFormat;
+        api.getFrameWidth = getFrameWidth;
+        api.getFrameHeight = getFrameHeight;
+        api.freeNode = freeNode;
+        api.getVideoInfo = getVideoInfo;
+        api.requestFrameFilter = requestFrameFilter;
+        api.getFrameFilter = getFrameFilter;
+        api.setFilterError = setFilterError;
+        api.mapSetError = mapSetError;
+        api.mapNumElements = mapNumElements;
+        api.mapGetInt = mapGetInt;
+        api.mapGetIntSaturated = mapGetIntSaturated;
+        api.mapGetIntArray = mapGetIntArray;
+        api.mapSetInt = mapSetInt;
+        api.mapGetFloat = mapGetFloat;
+        api.mapSetFloat = mapSetFloat;
+        api.mapGetData = mapGetData;
+        api.mapGetNode = mapGetNode;
+        api.getCoreInfo = getCoreInfo;
+        api.logMessage = logMessage;
+        return api;
+    }
+}
+
+// A pool of frames is cycled through instead of generating every frame, which would dominate the measurement. The
+// distorted frames are the reference ones plus noise, so the features have something to work on.
+static std::unique_ptr<VSNode> makeNode(const VSVideoFormat& format, int width, int height, int numFrames, const VSNode* reference) {
+    static constexpr auto poolSize{ 8 };
+
+    auto node{ std::make_unique<VSNode>() };
+    node->vi = { format, 24000, 1001, width, height, numFrames };
+
+    uint32_t seed{ reference ? 0x9E3779B9u : 1u };
+    auto peak{ (1 << format.bitsPerSample) - 1 };
+
+    for (auto i{ 0 }; i < poolSize; i++) {
+        auto frame{ std::make_unique<VSFrame>() };
+        frame->format = format;
+        frame->refs = 1;
+
+        size_t offset{};
+        std::array<size_t, 3> offsets{};
+
+        for (auto plane{ 0 }; plane < format.numPlanes; plane++) {
+            frame->width[plane] = plane ? width >> format.subSamplingW : width;
+            frame->height[plane] = plane ? height >> format.subSamplingH : height;
+            frame->stride[plane] = (static_cast<ptrdiff_t>(frame->width[plane]) * format.bytesPerSample + 63) & ~ptrdiff_t{ 63 };
+            offsets[plane] = offset;
+            offset += frame->stride[plane] * frame->height[plane];
+        }
+
+        frame->storage.resize(offset);
+
+        for (auto plane{ 0 }; plane < format.numPlanes; plane++) {
+            frame->data[plane] = frame->storage.data() + offsets[plane];
+
+            for (auto y{ 0 }; y < frame->height[plane]; y++) {
+                for (auto x{ 0 }; x < frame->width[plane]; x++) {
+                    int value;
+
+                    if (reference) {
+                        auto src{ reference->frames[i]->data[plane] + y * frame->stride[plane] };
+                        seed = seed * 1664525u + 1013904223u;
+                        value = (format.bytesPerSample == 1 ? src[x] : reinterpret_cast<const uint16_t*>(src)[x]) +
+                                static_cast<int>(seed >> 29) - 4;
+                    } else {
+                        value = ((x * 3 + y * 5 + i * 17) % 256) << (format.bitsPerSample - 8);
+                    }
+
+                    value = std::clamp(value, 0, peak);
+                    auto dst{ frame->data[plane] + y * frame->stride[plane] };
+
+                    if (format.bytesPerSample == 1)
+                        dst[x] = static_cast<uint8_t>(value);
+                    else
+                        reinterpret_cast<uint16_t*>(dst)[x] = static_cast<uint16_t>(value);
+                }
+            }
+        }
+
+        node->frames.push_back(std::move(frame));
+    }
+
+    return node;
+}
+
+static long peakRssKiB() noexcept {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds(Clock::duration duration) noexcept {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct Case final {
+    const char* filter;
+    const char* format;
+    int width;
+    int height;
+    int threads;
+    int frames;
+    int vmafThreads{ -1 };
+    int queueDepth{};
+};
+
+static void printCase(const Case& c, const char* mode) {
+    auto vmafThreads{ c.filter != "VMAF"s ? 0 : c.vmafThreads < 0 ? c.threads : c.vmafThreads };
+    std::printf(R"({"filter":"%s","mode":"%s","format":"%s","width":%d,"height":%d,"threads":%d,"vmaf_threads":%d,"queue_depth":%d,"frames":%d)",
+                c.filter, mode, c.format, c.width, c.height, c.threads, vmafThreads, c.queueDepth, c.frames);
+}
+
+static bool runPipeline(const Case& c, VSNode* reference, VSNode* distorted, const std::string& logPath, VSPublicFunction create, const VSAPI& api) {
+    VSCore core{ c.threads };
+    VSMap in{};
+    VSMap out{};
+
+    in.nodes["reference"] = { reference };
+    in.nodes["distorted"] = { distorted };
+
+    if (c.filter == "VMAF"s) {
+        in.data["log_path"] = { logPath };
+        in.ints["model"] = { 0 };
+
+        if (c.vmafThreads >= 0)
+            in.ints["threads"] = { c.vmafThreads };
+
+        if (c.queueDepth)
+            in.ints["queue_depth"] = { c.queueDepth };
+    } else {
+        in.ints["feature"] = { 0 };
+    }
+
+    auto start{ Clock::now() };
+    create(&in, &out, const_cast<char*>(c.filter), &core, &api);
+
+    if (!out.error.empty()) {
+        std::fprintf(stderr, "%s\n", out.error.c_str());
+        return false;
+    }
+
+    auto created{ Clock::now() };
+    std::atomic<int> next{};
+    std::atomic<bool> failed{};
+
+    // Frames are handed out in order, as vspipe requests them.
+    auto work{ [&] {
+        for (int n; !failed && (n = next++) < c.frames;) {
+            VSFrameContext frameCtx{};
+            void* frameData{};
+
+            out.getFrame(n, arInitial, out.instanceData, &frameData, &frameCtx, &core, &api);
+            auto frame{ out.getFrame(n, arAllFramesReady, out.instanceData, &frameData, &frameCtx, &core, &api) };
+
+            if (!frameCtx.error.empty()) {
+                std::fprintf(stderr, "%s\n", frameCtx.error.c_str());
+                failed = true;
+            }
+
+            api.freeFrame(frame);
+        }
+    } };
+
+    if (c.queueDepth) {
+        std::vector<std::thread> workers;
+        for (auto i{ 0 }; i < c.threads; i++)
+            workers.emplace_back(work);
+        for (auto&& w : workers)
+            w.join();
+    } else {
+        work();
+    }
+
+    if (failed) {
+        out.free(out.instanceData, &core, &api);
+        return false;
+    }
+
+    auto processed{ Clock::now() };
+    out.free(out.instanceData, &core, &api);
+    auto freed{ Clock::now() };
+
+    printCase(c, "pipeline");
+    std::printf(R"(,"create_ms":%.3f,"frames_ms":%.3f,"free_ms":%.3f,"fps":%.2f,"peak_rss_kib":%ld})"
+                "\n",
+                milliseconds(created - start), milliseconds(processed - created), milliseconds(freed - processed),
+                c.frames / std::chrono::duration<double>(freed - created).count(), peakRssKiB());
+    return true;
+}
+
+static bool runStages(const Case& c, VSNode* reference, VSNode* distorted, const std::string& logPath, const VSAPI& api) {
+    VSCore core{ c.threads };
+    VSMap in{};
+    VSMap out{};
+
+    in.nodes["reference"] = { reference };
+    in.nodes["distorted"] = { distorted };
+    in.data["log_path"] = { logPath };
+    in.ints["model"] = { 0 };
+
+    vmafCreate(&in, &out, const_cast<char*>("VMAF"), &core, &api);
+
+    if (!out.error.empty()) {
+        std::fprintf(stderr, "%s\n", out.error.c_str());
+        return false;
+    }
+
+    auto d{ static_cast<VMAFData*>(out.instanceData) };
+    auto numPlanes{ d->chroma ? d->vi->format.numPlanes : 1 };
+    Clock::duration alloc{}, copy{}, read{};
+    auto ok{ true };
+
+    for (auto n{ 0 }; n < c.frames && ok; n++) {
+        VmafPicture ref{}, dist{};
+
+        auto t0{ Clock::now() };
+        ok = allocPictures(d, ref, dist, true);
+        auto t1{ Clock::now() };
+
+        if (!ok)
+            break;
+
+        copyPicture(ref, api.getFrameFilter(n, reference, nullptr), numPlanes, d->region, &api);
+        copyPicture(dist, api.getFrameFilter(n, distorted, nullptr), numPlanes, d->region, &api);
+        auto t2{ Clock::now() };
+
+        ok = !vmaf_read_pictures(d->vmaf, &ref, &dist, n);
+        auto t3{ Clock::now() };
+
+        alloc += t1 - t0;
+        copy += t2 - t1;
+        read += t3 - t2;
+    }
+
+    auto t4{ Clock::now() };
+    ok = ok && !vmaf_read_pictures(d->vmaf, nullptr, nullptr, 0);
+    d->flushed = true;
+    auto t5{ Clock::now() };
+    ok = ok && !vmaf_write_output(d->vmaf, logPath.c_str(), d->logFormat);
+    auto t6{ Clock::now() };
+
+    out.free(out.instanceData, &core, &api);
+
+    if (!ok) {
+        std::fprintf(stderr, "VMAF: stage run failed\n");
+        return false;
+    }
+
+    auto total{ alloc + copy + read + (t6 - t4) };
+
+    printCase(c, "stages");
+    std::printf(R"(,"alloc_ms":%.3f,"copy_ms":%.3f,"read_pictures_ms":%.3f,"flush_ms":%.3f,"write_output_ms":%.3f,"fps":%.2f,"peak_rss_kib":%ld})"
+                "\n",
+                milliseconds(alloc), milliseconds(copy), milliseconds(read), milliseconds(t5 - t4), milliseconds(t6 - t5),
+                c.frames / std::chrono::duration<double>(total).count(), peakRssKiB());
+    return true;
+}
+
+// Both modes score the same frames on one thread. The pooled one goes through getFrame; the other one initializes,
+// flushes and closes a context for every frame like Metric did before contexts were pooled, including the copy of the
+// output frame so that only the context handling differs.
+static bool runMetricContexts(const Case& c, VSNode* reference, VSNode* distorted, const VSAPI& api) {
+    VSCore core{ c.threads };
+    VSMap in{};
+    VSMap out{};
+
+    in.nodes["reference"] = { reference };
+    in.nodes["distorted"] = { distorted };
+    in.ints["feature"] = { 0 };
+
+    metricCreate(&in, &out, nullptr, &core, &api);
+
+    if (!out.error.empty()) {
+        std::fprintf(stderr, "%s\n", out.error.c_str());
+        return false;
+    }
+
+    auto d{ static_cast<MetricData*>(out.instanceData) };
+    auto numPlanes{ d->chroma ? d->vi->format.numPlanes : 1 };
+    auto ok{ true };
+
+    auto t0{ Clock::now() };
+
+    for (auto n{ 0 }; n < c.frames && ok; n++) {
+        VSFrameContext frameCtx{};
+        void* frameData{};
+
+        out.getFrame(n, arInitial, out.instanceData, &frameData, &frameCtx, &core, &api);
+        api.freeFrame(out.getFrame(n, arAllFramesReady, out.instanceData, &frameData, &frameCtx, &core, &api));
+        ok = frameCtx.error.empty();
+    }
+
+    auto t1{ Clock::now() };
+
+    for (auto n{ 0 }; n < c.frames && ok; n++) {
+        VmafContext* vmaf{};
+        VmafPicture ref{}, dist{};
+        double score;
+
+        api.freeFrame(api.copyFrame(api.getFrameFilter(n, distorted, nullptr), &core));
+
+        ok = !vmaf_init(&vmaf, d->configuration);
+        for (auto&& f : d->feature)
+            ok = ok && !vmaf_use_feature(vmaf, featureName[f], nullptr);
+
+        ok = ok && !vmaf_picture_alloc(&ref, d->pixelFormat, d->vi->format.bitsPerSample, d->region.width, d->region.height) &&
+             !vmaf_picture_alloc(&dist, d->pixelFormat, d->vi->format.bitsPerSample, d->region.width, d->region.height);
+
+        if (ok) {
+            copyPicture(ref, api.getFrameFilter(n, reference, nullptr), numPlanes, d->region, &api);
+            copyPicture(dist, api.getFrameFilter(n, distorted, nullptr), numPlanes, d->region, &api);
+            ok = !vmaf_read_pictures(vmaf, &ref, &dist, n) && !vmaf_read_pictures(vmaf, nullptr, nullptr, 0);
+        } else {
+            vmaf_picture_unref(&ref);
+            vmaf_picture_unref(&dist);
+        }
+
+        for (auto&& f : d->featureScoreName)
+            ok = ok && !vmaf_feature_score_at_index(vmaf, f, &score, n);
+
+        vmaf_close(vmaf);
+    }
+
+    auto t2{ Clock::now() };
+
+    out.free(out.instanceData, &core, &api);
+
+    if (!ok) {
+        std::fprintf(stderr, "Metric: context run failed\n");
+        return false;
+    }
+
+    printCase(c, "context_pool");
+    std::printf(R"(,"frames_ms":%.3f,"fps":%.2f,"peak_rss_kib":%ld})"
+                "\n",
+                milliseconds(t1 - t0), c.frames / std::chrono::duration<double>(t1 - t0).count(), peakRssKiB());
+    printCase(c, "context_per_frame");
+    std::printf(R"(,"frames_ms":%.3f,"fps":%.2f,"peak_rss_kib":%ld})"
+                "\n",
+                milliseconds(t2 - t1), c.frames / std::chrono::duration<double>(t2 - t1).count(), peakRssKiB());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    auto frames{ argc > 1 ? std::max(std::atoi(argv[1]), 2) : 60 };
+    auto width{ argc > 2 ? std::max(std::atoi(argv[2]), 16) : 1920 };
+    auto height{ argc > 3 ? std::max(std::atoi(argv[3]), 16) : 1080 };
+
+    struct Format final {
+        const char* name;
+        VSVideoFormat format;
+    };
+
+    static constexpr Format formats[]{
+        { "YUV420P8", { cfYUV, stInteger, 8, 1, 1, 1, 3 } },
+        { "YUV420P10", { cfYUV, stInteger, 10, 2, 1, 1, 3 } },
+        { "YUV444P16", { cfYUV, stInteger, 16, 2, 0, 0, 3 } },
+    };
+
+    std::vector<int> threadCounts{ 1 };
+    if (auto hardware{ static_cast<int>(std::thread::hardware_concurrency()) }; hardware > 1)
+        threadCounts.push_back(hardware);
+
+    auto api{ standin::makeAPI() };
+    auto logPath{ (std::filesystem::temp_directory_path() / "vmaf_bench.xml").string() };
+    auto failed{ false };
+
+    for (auto&& f : formats) {
+        auto reference{ makeNode(f.format, width, height, frames, nullptr) };
+        auto distorted{ makeNode(f.format, width, height, frames, reference.get()) };
+
+        for (auto threads : threadCounts) {
+            failed |= !runPipeline({ "VMAF", f.name, width, height, threads, frames }, reference.get(), distorted.get(), logPath, vmafCreate, api);
+            failed |= !runStages({ "VMAF", f.name, width, height, threads, frames }, reference.get(), distorted.get(), logPath, api);
+        }
+
+        if (threadCounts.size() > 1) {
+            auto threads{ threadCounts.back() };
+            std::vector<int> budgets{ 1 };
+            if (threads / 2 > 1)
+                budgets.insert(budgets.begin(), threads / 2);
+
+            for (auto budget : budgets)
+                failed |= !runPipeline({ "VMAF", f.name, width, height, threads, frames, budget }, reference.get(), distorted.get(), logPath, vmafCreate, api);
+
+            failed |= !runPipeline({ "VMAF", f.name, width, height, threads, frames, -1, threads }, reference.get(), distorted.get(), logPath, vmafCreate, api);
+        }
+
+        failed |= !runPipeline({ "Metric", f.name, width, height, 1, frames }, reference.get(), distorted.get(), logPath, metricCreate, api);
+    }
+
+    for (auto&& [w, h] : { std::pair{ 1920, 1080 }, std::pair{ 3840, 2160 } }) {
+        auto reference{ makeNode(formats[0].format, w, h, frames, nullptr) };
+        auto distorted{ makeNode(formats[0].format, w, h, frames, reference.get()) };
+
+        failed |= !runMetricContexts({ "Metric", formats[0].name, w, h, 1, frames }, reference.get(), distorted.get(), api);
+    }
+
+    std::filesystem::remove(logPath);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/*
+    MIT License
+
+    Copyright (c) 2018-2022 HolyWu
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Compares copyPlane against vsh::bitblt on luma planes of common frame sizes.
+//
+// Usage: planecopy_bench [iterations]
+// Prints one tab-separated line per case: size, bits, shift, implementation, GB/s.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <VSHelper4.h>
+
+#include "../VMAF/PlaneCopy.h"
+
+// Frames handed out by VapourSynth and pictures allocated by libvmaf are both at least 32-byte aligned.
+static uint8_t* alignedData(std::vector<uint8_t>& storage, size_t bytes) {
+    void* p{ storage.data() };
+    auto space{ storage.size() };
+    return static_cast<uint8_t*>(std::align(64, bytes, p, space));
+}
+
+template<typename F>
+static double measure(int iterations, size_t bytes, F&& copy) {
+    copy();
+
+    auto start{ std::chrono::steady_clock::now() };
+    for (auto i{ 0 }; i < iterations; i++)
+        copy();
+    std::chrono::duration<double> elapsed{ std::chrono::steady_clock::now() - start };
+
+    return bytes * static_cast<double>(iterations) / elapsed.count() / 1e9;
+}
+
+int main(int argc, char** argv) {
+    auto iterations{ argc > 1 ? std::max(std::atoi(argv[1]), 1) : 100 };
+
+    struct Size final {
+        const char* name;
+        int width;
+        int height;
+    };
+
+    struct Depth final {
+        int bits;
+        int shift;
+    };
+
+    static constexpr Size sizes[]{ { "1080p", 1920, 1080 }, { "2160p", 3840, 2160 }, { "4320p", 7680, 4320 } };
+    static constexpr Depth depths[]{ { 8, 0 }, { 10, 0 }, { 16, 0 }, { 12, 2 }, { 16, 6 }, { 8, -2 }, { 10, -2 } };
+
+    std::printf("size\tbits\tshift\timpl\tGB/s\n");
+
+    for (auto&& size : sizes) {
+        for (auto&& depth : depths) {
+            auto bytesPerSample{ depth.bits > 8 ? 2 : 1 };
+            auto stride{ (static_cast<ptrdiff_t>(size.width) * bytesPerSample + 63) & ~ptrdiff_t{ 63 } };
+            auto bytes{ static_cast<size_t>(stride) * size.height };
+
+            // Raising the bit depth always writes 16-bit samples.
+            auto dstStride{ depth.shift < 0 ? (static_cast<ptrdiff_t>(size.width) * 2 + 63) & ~ptrdiff_t{ 63 } : stride };
+            auto dstBytes{ static_cast<size_t>(dstStride) * size.height };
+
+            std::vector<uint8_t> srcStorage(bytes + 64);
+            std::vector<uint8_t> dstStorage(dstBytes + 64);
+            auto src{ alignedData(srcStorage, bytes) };
+            auto dst{ alignedData(dstStorage, dstBytes) };
+
+            for (size_t i{}; i < bytes; i++)
+                src[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+
+            if (bytesPerSample == 2) {
+                auto samples{ reinterpret_cast<uint16_t*>(src) };
+                for (size_t i{}; i < bytes / 2; i++)
+                    samples[i] &= (1 << depth.bits) - 1;
+            }
+
+            auto rowBytes{ static_cast<size_t>(size.width) * bytesPerSample };
+            auto payload{ rowBytes * size.height };
+
+            if (!depth.shift) {
+                auto gbps{ measure(iterations, payload, [&] { vsh::bitblt(dst, stride, src, stride, rowBytes, size.height); }) };
+                std::printf("%s\t%d\t%d\tbitblt\t%.2f\n", size.name, depth.bits, depth.shift, gbps);
+            }
+
+            auto gbps{ measure(iterations, payload, [&] {
+                copyPlane(dst, dstStride, src, stride, size.width, size.height, bytesPerSample, depth.bits, depth.shift);
+            }) };
+            std::printf("%s\t%d\t%d\t%s\t%.2f\n", size.name, depth.bits, depth.shift, planeCopyIsa(), gbps);
+        }
+    }
+
+    return 0;
+}